@@ -0,0 +1,139 @@
+#ifndef Magnum_Examples_FluidSimulation2D_AlignedArray_h
+#define Magnum_Examples_FluidSimulation2D_AlignedArray_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2019 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Debug.h>
+
+namespace Magnum { namespace Examples {
+
+/* Growable array of trivially copyable values with 16-byte aligned storage,
+   suitable for SIMD loops. Grows geometrically, removal moves the last
+   element into the removed slot. */
+template<class T> class AlignedArray {
+    static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types are supported");
+
+    public:
+        enum: std::size_t { Alignment = 16 };
+
+        /*implicit*/ AlignedArray() = default;
+
+        AlignedArray(const AlignedArray<T>&) = delete;
+        AlignedArray(AlignedArray<T>&& other) noexcept { swap(other); }
+
+        ~AlignedArray() { std::free(_memory); }
+
+        AlignedArray<T>& operator=(const AlignedArray<T>&) = delete;
+        AlignedArray<T>& operator=(AlignedArray<T>&& other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        /* Accessors */
+
+        const T& operator[](std::size_t i) const {
+            CORRADE_INTERNAL_ASSERT(i < _size);
+            return _data[i];
+        }
+
+        T& operator[](std::size_t i) {
+            CORRADE_INTERNAL_ASSERT(i < _size);
+            return _data[i];
+        }
+
+        const T* data() const { return _data; }
+        T* data() { return _data; }
+
+        std::size_t size() const { return _size; }
+        std::size_t capacity() const { return _capacity; }
+        bool empty() const { return !_size; }
+
+        /* Modifiers */
+
+        void reserve(std::size_t capacity) {
+            if(capacity <= _capacity) return;
+
+            /* Allocate a whole number of aligned blocks and a bit more to be
+               able to align the beginning */
+            constexpr std::size_t BlockSize = Alignment/sizeof(T) ? Alignment/sizeof(T) : 1;
+            capacity = (capacity + BlockSize - 1)/BlockSize*BlockSize;
+            void* memory = std::malloc(capacity*sizeof(T) + Alignment - 1);
+            if(!memory) {
+                Fatal{} << "Can't allocate" << capacity*sizeof(T) << "bytes";
+            }
+            T* data = static_cast<T*>(reinterpret_cast<void*>(
+                (reinterpret_cast<std::uintptr_t>(memory) + Alignment - 1) & ~std::uintptr_t(Alignment - 1)));
+
+            if(_size) std::memcpy(data, _data, _size*sizeof(T));
+            std::free(_memory);
+            _memory = memory;
+            _data = data;
+            _capacity = capacity;
+        }
+
+        void resize(std::size_t size, const T& value = T{}) {
+            if(size > _capacity)
+                reserve(size > 2*_capacity ? size : 2*_capacity);
+            for(std::size_t i = _size; i < size; ++i)
+                _data[i] = value;
+            _size = size;
+        }
+
+        /* Keeps the capacity */
+        void clear() { _size = 0; }
+
+        void swapRemove(std::size_t i) {
+            CORRADE_INTERNAL_ASSERT(i < _size);
+            _data[i] = _data[--_size];
+        }
+
+        void swap(AlignedArray<T>& other) {
+            std::swap(_memory, other._memory);
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_capacity, other._capacity);
+        }
+
+    private:
+        void* _memory{};
+        T* _data{};
+        std::size_t _size{}, _capacity{};
+};
+
+}}
+
+#endif
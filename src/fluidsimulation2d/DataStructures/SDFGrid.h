@@ -0,0 +1,137 @@
+#ifndef Magnum_Examples_FluidSimulation2D_SDFGrid_h
+#define Magnum_Examples_FluidSimulation2D_SDFGrid_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2019 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Math/Range.h>
+
+#include "Array2X.h"
+#include "SDFProgram.h"
+
+namespace Magnum { namespace Examples {
+
+/* SDFProgram baked into grid nodes, together with analytic gradients. The
+   distance is clamped to a narrow band around the surface and the gradients
+   are zero outside of it, which means moving a primitive changes only nodes
+   within its bounds padded by the band width. Those get marked as dirty and
+   only they are evaluated again on the next rebake(). With an infinite band
+   width the whole field is kept, which is useful for static objects that
+   need distances and normals everywhere. */
+class SDFGrid {
+    public:
+        explicit SDFGrid(const Vector2& origin, Float cellSize, Int nI, Int nJ, Float bandWidth):
+            _origin{origin}, _cellSize{cellSize}, _invCellSize{1.0f/cellSize},
+            _bandWidth{bandWidth},
+            _values(nI + 1, nJ + 1, bandWidth),
+            _gradientsX(nI + 1, nJ + 1, 0.0f),
+            _gradientsY(nI + 1, nJ + 1, 0.0f) {}
+
+        Float bandWidth() const { return _bandWidth; }
+        const Array2X<Float>& values() const { return _values; }
+
+        /* Evaluates all nodes */
+        void bake(const SDFProgram& program) {
+            bakeNodes(program, {}, {Int(_values.sizeX()), Int(_values.sizeY())});
+            _dirty = false;
+        }
+
+        /* Marks nodes affected by a change in given world-space region */
+        void markDirty(const Range2D& worldRange) {
+            const Range2D padded = worldRange.padded(Vector2{_bandWidth + _cellSize});
+            const Vector2i min = Math::max(
+                Vector2i{Math::floor((padded.min() - _origin)*_invCellSize)},
+                Vector2i{0});
+            const Vector2i max = Math::min(
+                Vector2i{Math::ceil((padded.max() - _origin)*_invCellSize)} + Vector2i{1},
+                Vector2i{Int(_values.sizeX()), Int(_values.sizeY())});
+            if(!(min < max).all()) return;
+
+            const Range2Di range{min, max};
+            _dirtyRange = _dirty ? Math::join(_dirtyRange, range) : range;
+            _dirty = true;
+        }
+
+        bool isDirty() const { return _dirty; }
+
+        /* Evaluates only the dirty nodes, returns their count */
+        UnsignedInt rebake(const SDFProgram& program) {
+            if(!_dirty) return 0;
+            _dirty = false;
+            return bakeNodes(program, _dirtyRange.min(), _dirtyRange.max());
+        }
+
+        Float signedDistance(const Vector2& worldPos) const {
+            return _values.interpolateValue((worldPos - _origin)*_invCellSize);
+        }
+
+        /* Interpolated analytic gradient, normalized. Zero far outside of
+           the band. */
+        Vector2 gradient(const Vector2& worldPos) const {
+            const Vector2 gridPos = (worldPos - _origin)*_invCellSize;
+            Vector2 grad{_gradientsX.interpolateValue(gridPos),
+                         _gradientsY.interpolateValue(gridPos)};
+            const Float magSqr = grad.dot();
+            if(magSqr > 1.0e-20f) {
+                grad /= Math::sqrt(magSqr);
+            }
+            return grad;
+        }
+
+    private:
+        UnsignedInt bakeNodes(const SDFProgram& program, const Vector2i& min, const Vector2i& max) {
+            for(Int j = min.y(); j < max.y(); ++j) {
+                for(Int i = min.x(); i < max.x(); ++i) {
+                    Vector2 grad;
+                    Float dist = program.signedDistance(_origin + Vector2{Float(i), Float(j)}*_cellSize, grad);
+                    if(Math::abs(dist) >= _bandWidth) {
+                        dist = dist < 0 ? -_bandWidth : _bandWidth;
+                        grad = {};
+                    }
+                    _values(i, j) = dist;
+                    _gradientsX(i, j) = grad.x();
+                    _gradientsY(i, j) = grad.y();
+                }
+            }
+            return UnsignedInt((max - min).product());
+        }
+
+        Vector2 _origin;
+        Float _cellSize, _invCellSize, _bandWidth;
+        Array2X<Float> _values, _gradientsX, _gradientsY;
+        Range2Di _dirtyRange;
+        bool _dirty = true;
+};
+
+}}
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef Magnum_Examples_FluidSimulation2D_SDFProgram_h
+#define Magnum_Examples_FluidSimulation2D_SDFProgram_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2019 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <vector>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Macros.h>
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/Math/Vector2.h>
+
+#include "SDFObject.h"
+
+namespace Magnum { namespace Examples {
+
+/* Flattened version of a SDFObject tree. The tree is compiled into a linear
+   list of instructions in post-order, which is then evaluated using a small
+   fixed-size stack, without any recursion or pointer chasing. Primitives can
+   be moved after compilation, in which case the region affected by the
+   change is returned so baked data can be updated incrementally. */
+class SDFProgram {
+    public:
+        enum: UnsignedInt { MaxStackDepth = 16 };
+
+        struct Instruction {
+            SDFObject::ObjectType type;
+            bool negativeInside;
+            Vector2 center;
+            Vector2 radii;
+        };
+
+        /*implicit*/ SDFProgram() = default;
+        explicit SDFProgram(const SDFObject& root) { compile(root); }
+
+        void compile(const SDFObject& root) {
+            _instructions.clear();
+            _primitives.clear();
+            UnsignedInt depth = 0;
+            _maxDepth = 0;
+            compileNode(root, depth);
+            CORRADE_INTERNAL_ASSERT(depth == 1);
+        }
+
+        std::size_t instructionCount() const { return _instructions.size(); }
+        UnsignedInt primitiveCount() const { return UnsignedInt(_primitives.size()); }
+        const Instruction& primitive(UnsignedInt id) const {
+            return _instructions[_primitives[id]];
+        }
+
+        /* World-space bounds of the zero level set of given primitive */
+        Range2D primitiveBounds(UnsignedInt id) const {
+            const Instruction& instruction = _instructions[_primitives[id]];
+            const Vector2 radii = instruction.type == SDFObject::ObjectType::Circle ?
+                Vector2{instruction.radii[0]} : instruction.radii;
+            return {instruction.center - radii, instruction.center + radii};
+        }
+
+        /* Union of bounds of all primitives */
+        Range2D bounds() const {
+            Range2D bounds;
+            for(UnsignedInt id = 0; id != primitiveCount(); ++id)
+                bounds = id ? Math::join(bounds, primitiveBounds(id)) : primitiveBounds(id);
+            return bounds;
+        }
+
+        /* Moves a primitive, returns the union of its old and new bounds */
+        Range2D setPrimitiveCenter(UnsignedInt id, const Vector2& center) {
+            const Range2D oldBounds = primitiveBounds(id);
+            _instructions[_primitives[id]].center = center;
+            return Math::join(oldBounds, primitiveBounds(id));
+        }
+
+        /* Moves the whole object, returns the union of all affected bounds */
+        Range2D translate(const Vector2& offset) {
+            Range2D affected;
+            for(UnsignedInt id = 0; id != primitiveCount(); ++id) {
+                const Range2D bounds = setPrimitiveCenter(id, primitive(id).center + offset);
+                affected = id ? Math::join(affected, bounds) : bounds;
+            }
+            return affected;
+        }
+
+        Float signedDistance(const Vector2& pos) const {
+            Float stack[MaxStackDepth];
+            UnsignedInt top = 0;
+            for(const Instruction& instruction: _instructions) {
+                switch(instruction.type) {
+                    case SDFObject::ObjectType::Circle:
+                        stack[top++] = circle(instruction, pos, nullptr);
+                        break;
+                    case SDFObject::ObjectType::Box:
+                        stack[top++] = box(instruction, pos, nullptr);
+                        break;
+                    case SDFObject::ObjectType::Intersection:
+                        --top;
+                        stack[top - 1] = Math::max(stack[top - 1], stack[top]);
+                        break;
+                    case SDFObject::ObjectType::Subtraction:
+                        --top;
+                        stack[top - 1] = Math::max(stack[top - 1], -stack[top]);
+                        break;
+                    case SDFObject::ObjectType::Union:
+                        --top;
+                        stack[top - 1] = Math::min(stack[top - 1], stack[top]);
+                        break;
+                }
+            }
+            return stack[0];
+        }
+
+        /* Same as above, but additionally propagates the analytic gradient of
+           the primitive that defines the distance at given point */
+        Float signedDistance(const Vector2& pos, Vector2& gradient) const {
+            Float stack[MaxStackDepth];
+            Vector2 gradientStack[MaxStackDepth];
+            UnsignedInt top = 0;
+            for(const Instruction& instruction: _instructions) {
+                switch(instruction.type) {
+                    case SDFObject::ObjectType::Circle:
+                        stack[top] = circle(instruction, pos, &gradientStack[top]);
+                        ++top;
+                        break;
+                    case SDFObject::ObjectType::Box:
+                        stack[top] = box(instruction, pos, &gradientStack[top]);
+                        ++top;
+                        break;
+                    case SDFObject::ObjectType::Subtraction:
+                        stack[top - 1] = -stack[top - 1];
+                        gradientStack[top - 1] = -gradientStack[top - 1];
+                        CORRADE_FALLTHROUGH
+                    case SDFObject::ObjectType::Intersection:
+                        --top;
+                        if(stack[top] > stack[top - 1]) {
+                            stack[top - 1] = stack[top];
+                            gradientStack[top - 1] = gradientStack[top];
+                        }
+                        break;
+                    case SDFObject::ObjectType::Union:
+                        --top;
+                        if(stack[top] < stack[top - 1]) {
+                            stack[top - 1] = stack[top];
+                            gradientStack[top - 1] = gradientStack[top];
+                        }
+                        break;
+                }
+            }
+            gradient = gradientStack[0];
+            return stack[0];
+        }
+
+    private:
+        void compileNode(const SDFObject& node, UnsignedInt& depth) {
+            if(node.type == SDFObject::ObjectType::Circle ||
+               node.type == SDFObject::ObjectType::Box) {
+                _primitives.push_back(UnsignedInt(_instructions.size()));
+                ++depth;
+            } else {
+                CORRADE_INTERNAL_ASSERT(node.obj1 && node.obj2);
+                compileNode(*node.obj1, depth);
+                compileNode(*node.obj2, depth);
+                --depth;
+            }
+
+            _maxDepth = Math::max(_maxDepth, depth);
+            if(_maxDepth > MaxStackDepth) {
+                Fatal{} << "SDF tree too deep to compile";
+            }
+
+            _instructions.push_back(Instruction{node.type, node.negativeInside, node.center, node.radii});
+        }
+
+        static Float circle(const Instruction& instruction, const Vector2& pos, Vector2* gradient) {
+            const Vector2 d = pos - instruction.center;
+            const Float length = d.length();
+            const Float dist = length - instruction.radii[0];
+            if(gradient) {
+                *gradient = length > 1.0e-10f ? d/length : Vector2::xAxis();
+                if(!instruction.negativeInside) *gradient = -*gradient;
+            }
+            return instruction.negativeInside ? dist : -dist;
+        }
+
+        static Float box(const Instruction& instruction, const Vector2& pos, Vector2* gradient) {
+            const Vector2 d = pos - instruction.center;
+            const Vector2 s{d[0] < 0 ? -1.0f : 1.0f, d[1] < 0 ? -1.0f : 1.0f};
+            const Float dx = Math::abs(d[0]) - instruction.radii[0];
+            const Float dy = Math::abs(d[1]) - instruction.radii[1];
+            Float dist;
+            Vector2 grad;
+            if(dx < 0 && dy < 0) {
+                if(dx > dy) {
+                    dist = dx;
+                    grad = {s[0], 0.0f};
+                } else {
+                    dist = dy;
+                    grad = {0.0f, s[1]};
+                }
+            } else {
+                const Float dax = Math::max(dx, 0.0f);
+                const Float day = Math::max(dy, 0.0f);
+                dist = Math::sqrt(dax*dax + day*day);
+                grad = dist > 1.0e-10f ? Vector2{dax*s[0], day*s[1]}/dist : Vector2{s[0], 0.0f};
+            }
+            if(gradient)
+                *gradient = instruction.negativeInside ? grad : -grad;
+            return instruction.negativeInside ? dist : -dist;
+        }
+
+        std::vector<Instruction> _instructions;
+        /* Indices of primitive instructions in _instructions */
+        std::vector<UnsignedInt> _primitives;
+        UnsignedInt _maxDepth = 0;
+};
+
+}}
+
+#endif
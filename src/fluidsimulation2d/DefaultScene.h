@@ -0,0 +1,69 @@
+#ifndef Magnum_Examples_FluidSimulation2D_DefaultScene_h
+#define Magnum_Examples_FluidSimulation2D_DefaultScene_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2019 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <Magnum/Math/Vector2.h>
+
+#include "FluidSolver/SolverData.h"
+
+namespace Magnum { namespace Examples {
+
+/* Scene shared by the interactive example and the headless benchmark */
+
+constexpr Float GridCellLength = 1.0f;      /* length of 1 grid cell */
+constexpr Vector2i NumGridCells{100, 100};   /* number of cells */
+constexpr Vector2 GridStart{-50.0f, -50.0f}; /* lower corner of the grid */
+constexpr Int RadiusCircleBoundary = 45; /* radius of the boundary circle */
+
+/* Simulation starts after a short pause, then particles get emitted
+   automatically a few times */
+constexpr Float SimulationStartTime = 1.0f;
+constexpr Float AutoEmitStartTime = 10.0f;
+constexpr Float AutoEmitInterval = 1.5f;
+constexpr Int AutoEmitCount = 5;
+
+inline Vector2 gridCenter() {
+    return Vector2{NumGridCells}*GridCellLength*0.5f + GridStart;
+}
+
+/* Ownership is passed to the solver */
+inline SceneObjects* createDefaultSceneObjects() {
+    SceneObjects* sceneObjs = new SceneObjects;
+    sceneObjs->emitterT0 = SDFObject{gridCenter() + Vector2(10.0f, 10.0f), 30.0f, SDFObject::ObjectType::Circle};
+    sceneObjs->emitter = SDFObject{gridCenter() + Vector2(15.0f, 20.0f), 15.0f, SDFObject::ObjectType::Circle};
+    sceneObjs->boundary = SDFObject{gridCenter(), Float(RadiusCircleBoundary), SDFObject::ObjectType::Circle, false};
+    return sceneObjs;
+}
+
+}}
+
+#endif
@@ -35,7 +35,6 @@
 #include <Corrade/Containers/ArrayView.h>
 #include <Magnum/GL/Renderer.h>
 #include <Magnum/Math/Functions.h>
-#include <Magnum/Shaders/GenericGL.h>
 #include <Magnum/SceneGraph/Drawable.h>
 #include <Magnum/Trade/MeshData.h>
 
@@ -43,30 +42,36 @@ namespace Magnum { namespace Examples {
 
 using namespace Math::Literals;
 
-ParticleGroup2D::ParticleGroup2D(const std::vector<Vector2>& points, Float particleRadius):
+ParticleGroup2D::ParticleGroup2D(const AlignedArray<Float>& pointsX, const AlignedArray<Float>& pointsY, Float particleRadius):
     /* With {}, GCC 4.8 warns that "a temporary bound to '_points' only
        persists until the constructor exits" (?!) */
-    _points(points),
+    _pointsX(pointsX),
+    _pointsY(pointsY),
     _particleRadius{particleRadius},
     _meshParticles{GL::MeshPrimitive::Points}
 {
-    _meshParticles.addVertexBuffer(_bufferParticles, 0, Shaders::GenericGL2D::Position{});
+    /* The solver stores positions as separate component arrays, upload them
+       as-is to two buffers instead of interleaving them on every frame */
+    _meshParticles
+        .addVertexBuffer(_bufferParticlesX, 0, ParticleSphereShader2D::PositionX{})
+        .addVertexBuffer(_bufferParticlesY, 0, ParticleSphereShader2D::PositionY{});
     _particleShader.reset(new ParticleSphereShader2D);
 }
 
 ParticleGroup2D& ParticleGroup2D::draw(Containers::Pointer<SceneGraph::Camera2D>& camera, Int screenHeight, Int projectionHeight) {
-    if(_points.empty()) return *this;
+    if(_pointsX.empty()) return *this;
 
     if(_dirty) {
-        Containers::ArrayView<const float> data(reinterpret_cast<const float*>(&_points[0]), _points.size() * 2);
-        _bufferParticles.setData(data);
-        _meshParticles.setCount(Int(_points.size()));
+        CORRADE_INTERNAL_ASSERT(_pointsX.size() == _pointsY.size());
+        _bufferParticlesX.setData(Containers::arrayView(_pointsX.data(), _pointsX.size()));
+        _bufferParticlesY.setData(Containers::arrayView(_pointsY.data(), _pointsY.size()));
+        _meshParticles.setCount(Int(_pointsX.size()));
         _dirty = false;
     }
 
     (*_particleShader)
         /* particle data */
-        .setNumParticles(Int(_points.size()))
+        .setNumParticles(Int(_pointsX.size()))
         .setParticleRadius(_particleRadius)
         /* sphere render data */
         .setColorMode(_colorMode)
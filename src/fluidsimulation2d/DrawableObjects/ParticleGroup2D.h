@@ -31,20 +31,21 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#include <vector>
 #include <Corrade/Containers/Pointer.h>
 #include <Magnum/GL/Buffer.h>
 #include <Magnum/GL/Mesh.h>
 #include <Magnum/Math/Color.h>
 #include <Magnum/SceneGraph/Camera.h>
 
+#include "DataStructures/AlignedArray.h"
 #include "Shaders/ParticleSphereShader2D.h"
 
 namespace Magnum { namespace Examples {
 
 class ParticleGroup2D {
     public:
-        explicit ParticleGroup2D(const std::vector<Vector2>& points, Float particleRadius);
+        /* Positions are passed as separate X and Y component arrays */
+        explicit ParticleGroup2D(const AlignedArray<Float>& pointsX, const AlignedArray<Float>& pointsY, Float particleRadius);
 
         ParticleGroup2D& draw(Containers::Pointer<SceneGraph::Camera2D>& camera, Int screenHeight, Int projectionHeight);
 
@@ -77,14 +78,16 @@ class ParticleGroup2D {
         }
 
     private:
-        const std::vector<Vector2>& _points;
+        const AlignedArray<Float>& _pointsX;
+        const AlignedArray<Float>& _pointsY;
         bool _dirty = false;
 
         Float _particleRadius = 1.0f;
         ParticleSphereShader2D::ColorMode _colorMode = ParticleSphereShader2D::ColorMode::RampColorById;
         Color3 _color{0.1f};
 
-        GL::Buffer _bufferParticles;
+        GL::Buffer _bufferParticlesX;
+        GL::Buffer _bufferParticlesY;
         GL::Mesh   _meshParticles;
         Containers::Pointer<ParticleSphereShader2D> _particleShader;
 };
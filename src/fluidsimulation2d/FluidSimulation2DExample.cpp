@@ -51,6 +51,7 @@
 #include <Magnum/Timeline.h>
 #include <Magnum/Trade/MeshData.h>
 
+#include "DefaultScene.h"
 #include "DrawableObjects/ParticleGroup2D.h"
 #include "DrawableObjects/WireframeObject2D.h"
 #include "FluidSolver/ApicSolver2D.h"
@@ -75,6 +76,7 @@ class FluidSimulation2DExample: public Platform::Application {
         /* Fluid simulation helper functions */
         void resetSimulation();
         Vector2 windowPos2WorldPos(const Vector2& winPos);
+        void updateEmitterTransformation();
 
         /* Window control */
         void showMenu();
@@ -108,23 +110,19 @@ class FluidSimulation2DExample: public Platform::Application {
         Float _mouseInteractionRadius = 5.0f;
         Float _mouseInteractionMagnitude = 5.0f;
         bool _bMouseInteraction = true;
+
+        /* Emitter dragging with the right mouse button */
+        Containers::Pointer<WireframeObject2D> _drawableEmitter;
+        Vector2 _lastEmitterDragWorldPos;
+        bool _draggingEmitter = false;
 };
 
 namespace {
 
-constexpr Float GridCellLength = 1.0f;      /* length of 1 grid cell */
-constexpr Vector2i NumGridCells{100, 100};   /* number of cells */
-constexpr Vector2 GridStart{-50.0f, -50.0f}; /* lower corner of the grid */
-constexpr Int RadiusCircleBoundary = 45; /* radius of the boundary circle */
-
 /* Viewport will display this window */
 constexpr Float ProjectionScale = 1.05f;
 const Vector2i DomainDisplaySize = NumGridCells*GridCellLength*ProjectionScale;
 
-Vector2 gridCenter() {
-    return Vector2{NumGridCells}*GridCellLength*0.5f + GridStart;
-}
-
 }
 
 using namespace Math::Literals;
@@ -186,14 +184,11 @@ FluidSimulation2DExample::FluidSimulation2DExample(const Arguments& arguments):
 
     /* Setup fluid solver */
     {
-        SceneObjects* sceneObjs = new SceneObjects;
-        sceneObjs->emitterT0 = SDFObject{gridCenter() + Vector2(10.0f, 10.0f), 30.0f, SDFObject::ObjectType::Circle};
-        sceneObjs->emitter = SDFObject{gridCenter() + Vector2(15.0f, 20.0f), 15.0f, SDFObject::ObjectType::Circle};
-        sceneObjs->boundary = SDFObject{gridCenter(), Float(RadiusCircleBoundary), SDFObject::ObjectType::Circle, false};
-        _fluidSolver.emplace(GridStart, GridCellLength, NumGridCells.x(), NumGridCells.y(), sceneObjs);
+        _fluidSolver.emplace(GridStart, GridCellLength, NumGridCells.x(), NumGridCells.y(), createDefaultSceneObjects());
 
         /* Drawable particles */
-        _drawableParticles.emplace(_fluidSolver->particlePositions(),
+        _drawableParticles.emplace(_fluidSolver->particlePositionsX(),
+                                   _fluidSolver->particlePositionsY(),
                                    _fluidSolver->particleRadius());
         _drawableParticles->setColor(0x55c8f5_rgbf);
 
@@ -208,6 +203,13 @@ FluidSimulation2DExample::FluidSimulation2DExample(const Arguments& arguments):
             MeshTools::compile(Primitives::circle2DWireframe(32)));
         _drawablePointer->setColor(0x00ff00_rgbf);
         _drawablePointer->setEnabled(false);
+
+        /* Outline of the emitter, shown while it's being dragged */
+        _drawableEmitter.emplace(_scene.get(), _drawableGroup.get(),
+            MeshTools::compile(Primitives::circle2DWireframe(64)));
+        _drawableEmitter->setColor(0xffa500_rgbf);
+        _drawableEmitter->setEnabled(false);
+        updateEmitterTransformation();
     }
 
     /* Enable depth test, render particles as sprites */
@@ -243,14 +245,14 @@ void FluidSimulation2DExample::drawEvent() {
     if(!_pausedSimulation) {
         constexpr Float frameTime = 1.0f/60.0f;
         /* pause for a while before starting simulation */
-        if(_evolvedTime > 1.0f) _fluidSolver->advanceFrame(frameTime*_speed);
+        if(_evolvedTime > SimulationStartTime) _fluidSolver->advanceFrame(frameTime*_speed);
         _evolvedTime += frameTime;
 
         /* Emit particles automatically */
-        if(_bAutoEmitParticles && _evolvedTime > 10.0f) {
+        if(_bAutoEmitParticles && _evolvedTime > AutoEmitStartTime) {
             static Float lastTime = _evolvedTime;
-            if(_evolvedTime - lastTime > 1.5f && /* emit every 1.5 second */
-               _numEmission < 5)                 /* emit 5 times */
+            if(_evolvedTime - lastTime > AutoEmitInterval &&
+               _numEmission < AutoEmitCount)
             {
                 _fluidSolver->emitParticles();
                 lastTime = _evolvedTime;
@@ -333,8 +335,18 @@ void FluidSimulation2DExample::pointerPressEvent(PointerEvent& event) {
         return;
     }
 
-    if(!event.isPrimary() ||
-       !(event.pointer() & (Pointer::MouseLeft|Pointer::Finger)))
+    if(!event.isPrimary())
+        return;
+
+    if(event.pointer() & Pointer::MouseRight) {
+        _draggingEmitter = true;
+        _lastEmitterDragWorldPos = windowPos2WorldPos(event.position());
+        _drawableEmitter->setEnabled(true);
+        event.setAccepted();
+        return;
+    }
+
+    if(!(event.pointer() & (Pointer::MouseLeft|Pointer::Finger)))
         return;
 
     _lastMousePressedWorldPos = windowPos2WorldPos(event.position());
@@ -352,8 +364,17 @@ void FluidSimulation2DExample::pointerReleaseEvent(PointerEvent& event) {
     if(_imGuiContext.handlePointerReleaseEvent(event))
         event.setAccepted(true);
 
-    if(!event.isPrimary() ||
-       !(event.pointer() & (Pointer::MouseLeft|Pointer::Finger)))
+    if(!event.isPrimary())
+        return;
+
+    if(_draggingEmitter && (event.pointer() & Pointer::MouseRight)) {
+        _draggingEmitter = false;
+        _drawableEmitter->setEnabled(false);
+        event.setAccepted();
+        return;
+    }
+
+    if(!(event.pointer() & (Pointer::MouseLeft|Pointer::Finger)))
         return;
 
     if(_bMouseInteraction) {
@@ -368,8 +389,21 @@ void FluidSimulation2DExample::pointerMoveEvent(PointerMoveEvent& event) {
         return;
     }
 
-    if(!event.isPrimary() ||
-       !(event.pointers() & (Pointer::MouseLeft|Pointer::Finger)))
+    if(!event.isPrimary())
+        return;
+
+    /* Only the region around the old and new emitter position gets baked
+       again on the next emission */
+    if(_draggingEmitter && (event.pointers() & Pointer::MouseRight)) {
+        const Vector2 currentPos = windowPos2WorldPos(event.position());
+        _fluidSolver->moveEmitter(currentPos - _lastEmitterDragWorldPos);
+        _lastEmitterDragWorldPos = currentPos;
+        updateEmitterTransformation();
+        event.setAccepted();
+        return;
+    }
+
+    if(!(event.pointers() & (Pointer::MouseLeft|Pointer::Finger)))
         return;
 
     const Vector2 currentPos = windowPos2WorldPos(event.position());
@@ -413,7 +447,10 @@ void FluidSimulation2DExample::showMenu() {
 
     /* General information */
     ImGui::Text("Hide/show menu: H");
+    ImGui::Text("Move emitter: right mouse drag");
     ImGui::Text("Num. particles: %d",   Int(_fluidSolver->numParticles()));
+    ImGui::Text("Removed particles: %d", Int(_fluidSolver->removedParticleCount()));
+    ImGui::Text("Emitter nodes re-baked: %d", Int(_fluidSolver->rebakedEmitterNodeCount()));
     ImGui::Text("Rendering: %3.2f FPS", Double(ImGui::GetIO().Framerate));
     ImGui::Spacing();
 
@@ -449,6 +486,22 @@ void FluidSimulation2DExample::showMenu() {
         ImGui::Checkbox("Auto emit particles 5 times", &_bAutoEmitParticles);
         ImGui::PopItemWidth();
         ImGui::BeginGroup();
+        {
+            ParticleCulling& culling = _fluidSolver->particleCulling();
+            Int maxParticleCount = Int(culling.maxParticleCount);
+            ImGui::PushItemWidth(ImGui::GetWindowWidth()*0.3f);
+            if(ImGui::InputInt("Max particles (0 = unlimited)", &maxParticleCount, 1000))
+                culling.maxParticleCount = UnsignedInt(Math::max(maxParticleCount, 0));
+            ImGui::PopItemWidth();
+            /* Removes particles close to the bottom of the boundary circle */
+            if(ImGui::Checkbox("Drain at the bottom", &culling.killPlane)) {
+                culling.killPlaneNormal = Vector2::yAxis();
+                culling.killPlaneOffset = gridCenter().y() - RadiusCircleBoundary + 2.0f*GridCellLength;
+            }
+            ImGui::Checkbox("Stable particle order", &culling.stableOrder);
+        }
+        ImGui::EndGroup();
+        ImGui::BeginGroup();
         ImGui::Checkbox("Mouse interaction", &_bMouseInteraction);
         if(_bMouseInteraction) {
             ImGui::PushItemWidth(ImGui::GetWindowWidth()*0.5f);
@@ -486,6 +539,13 @@ void FluidSimulation2DExample::resetSimulation() {
     _numEmission = 0;
 }
 
+void FluidSimulation2DExample::updateEmitterTransformation() {
+    const Range2D bounds = _fluidSolver->emitterBounds();
+    _drawableEmitter->setTransformation(
+        Matrix3::translation(bounds.center())*
+        Matrix3::scaling(bounds.size()*0.5f));
+}
+
 Vector2 FluidSimulation2DExample::windowPos2WorldPos(const Vector2& windowPosition) {
     /* First scale the position from being relative to window size to being
        relative to framebuffer size as those two can be different on HiDPI
@@ -32,13 +32,16 @@
 #include "FluidSolver/ApicSolver2D.h"
 
 #include <random>
+#include <Magnum/Math/Constants.h>
 
 namespace Magnum { namespace Examples {
 
 ApicSolver2D::ApicSolver2D(const Vector2& origin, Float cellSize, Int nI, Int nJ, SceneObjects* sceneObjs):
     _objects{sceneObjs},
     _particles{cellSize},
-    _grid{origin, cellSize, nI, nJ}
+    _grid{origin, cellSize, nI, nJ},
+    _boundaryGrid{origin, cellSize, nI, nJ, Constants::inf()},
+    _emitterGrid{origin, cellSize, nI, nJ, 2.0f*cellSize}
 {
     if(nI < 1 || nJ < 1) {
         Fatal{} << "Invalid grid resolution";
@@ -47,29 +50,37 @@ ApicSolver2D::ApicSolver2D(const Vector2& origin, Float cellSize, Int nI, Int nJ
         Fatal{} << "Invalid scene object";
     }
 
+    /* Flatten the SDF trees so they don't need to be walked recursively for
+       every sample */
+    _boundaryProgram.compile(_objects->boundary);
+    _emitterProgram.compile(_objects->emitter);
+    _emitterGrid.bake(_emitterProgram);
+
     /* Initialize data */
     initBoundary();
-    generateParticles(_objects->emitterT0, 0);
+    generateParticles(SDFProgram{_objects->emitterT0}, 0);
 }
 
 /* This function should be called again every time the boundary changes */
 void ApicSolver2D::initBoundary() {
-    _grid.boundarySDF.loop2D([&](std::size_t i, std::size_t j) {
-        _grid.boundarySDF(i, j) = _objects->boundary.signedDistance(_grid.getWorldPos({Float(i), Float(j)}));
+    _boundaryGrid.bake(_boundaryProgram);
+    const Array2X<Float>& boundarySDF = _boundaryGrid.values();
+    _grid.boundaryCellSDF.loop2D([&](std::size_t i, std::size_t j) {
+        _grid.boundaryCellSDF(i, j) = _boundaryProgram.signedDistance(_grid.getWorldPos({i + 0.5f, j + 0.5f}));
     });
 
     /* Initialize the fluid cell weights from boundary signed distance field */
     _grid.uWeights.loop2D([&](std::size_t i, std::size_t j) {
-        _grid.uWeights(i, j) = Float(1) - fractionInside(_grid.boundarySDF(i, j + 1), _grid.boundarySDF(i, j));
+        _grid.uWeights(i, j) = Float(1) - fractionInside(boundarySDF(i, j + 1), boundarySDF(i, j));
         _grid.uWeights(i, j) = Math::clamp(_grid.uWeights(i, j), Float(0), Float(1));
     });
     _grid.vWeights.loop2D([&](std::size_t i, std::size_t j) {
-        _grid.vWeights(i, j) = Float(1) - fractionInside(_grid.boundarySDF(i + 1, j), _grid.boundarySDF(i, j));
+        _grid.vWeights(i, j) = Float(1) - fractionInside(boundarySDF(i + 1, j), boundarySDF(i, j));
         _grid.vWeights(i, j) = Math::clamp(_grid.vWeights(i, j), Float(0), Float(1));
     });
 }
 
-void ApicSolver2D::generateParticles(const SDFObject& sdfObj, Float initialVelocity_y) {
+template<class SignedDistance> void ApicSolver2D::generateParticles(const SignedDistance& sdf, Float initialVelocity_y) {
     using Distribution = std::uniform_real_distribution<Float>;
     const Float rndScale = _particles.particleRadius*0.5f;
     std::mt19937 gen(std::random_device{}());
@@ -82,7 +93,7 @@ void ApicSolver2D::generateParticles(const SDFObject& sdfObj, Float initialVeloc
             const Vector2 cellCenter = _grid.getWorldPos({i + 0.5f, j + 0.5f});
             for(Int k = 0; k < 2; ++k) {
                 const Vector2 ppos = cellCenter + Vector2(distr(gen), distr(gen));
-                if(sdfObj.signedDistance(ppos) < 0) {
+                if(sdf.signedDistance(ppos) < 0) {
                     newParticles.push_back(ppos);
                 }
             }
@@ -92,6 +103,52 @@ void ApicSolver2D::generateParticles(const SDFObject& sdfObj, Float initialVeloc
     _particles.addParticles(newParticles, initialVelocity_y);
 }
 
+void ApicSolver2D::emitParticles() {
+    /* Re-evaluate only the parts of the emitter that moved since last time */
+    _rebakedEmitterNodeCount = _emitterGrid.rebake(_emitterProgram);
+    generateParticles(_emitterGrid, 10);
+    cullParticles();
+}
+
+UnsignedInt ApicSolver2D::cullParticles() {
+    ScopedStageTimer timer{_statistics, SolverStatistics::Stage::Cull};
+
+    const Vector2 domainMin = _grid.origin;
+    const Vector2 domainMax = _grid.getWorldPos(Vector2{Float(_grid.nI), Float(_grid.nJ)});
+    const ParticleCulling culling = _culling;
+
+    /* Out-of-domain and kill plane test. Written so NaN positions get
+       removed as well. */
+    _keepParticles.resize(_particles.size());
+    TaskScheduler::forEach(std::size_t(_particles.size()), [&](std::size_t p) {
+        const Vector2 ppos = _particles.position(UnsignedInt(p));
+        bool keep = (ppos >= domainMin).all() && (ppos < domainMax).all();
+        if(culling.killPlane && !(Math::dot(ppos, culling.killPlaneNormal) >= culling.killPlaneOffset))
+            keep = false;
+        _keepParticles[p] = keep;
+    });
+    UnsignedInt removed = _particles.compact(_keepParticles, culling.stableOrder);
+
+    /* Particle budget, applied on what's left */
+    if(culling.maxParticleCount && _particles.size() > culling.maxParticleCount) {
+        const UnsignedInt excess = _particles.size() - culling.maxParticleCount;
+        _keepParticles.resize(_particles.size());
+        TaskScheduler::forEach(std::size_t(_particles.size()), [&](std::size_t p) {
+            _keepParticles[p] = p >= excess;
+        });
+        removed += _particles.compact(_keepParticles, culling.stableOrder);
+    }
+
+    /* Compacting changed the particle indices. The cell lists are used by
+       addRepulsiveVelocity() between steps, so they'd point past the end or
+       to different particles. */
+    if(removed) collectParticlesToCells();
+
+    _removedParticleCount += removed;
+    if(_statistics) _statistics->removedParticles += removed;
+    return removed;
+}
+
 void ApicSolver2D::addRepulsiveVelocity(const Vector2& p0, const Vector2& p1, Float dt, Float radius, Float magnitude) {
     Vector2 movingVel  = p1 - p0;
     const Float movingDist = movingVel.length();
@@ -124,11 +181,12 @@ void ApicSolver2D::addRepulsiveVelocity(const Vector2& p0, const Vector2& p1, Fl
 
             const std::vector<UnsignedInt>& particleIdxs = _grid.cellParticles(i, j);
             for(UnsignedInt p: particleIdxs) {
-                const Float dist = distToSegment(_particles.positions[p]);
+                const Float dist = distToSegment(_particles.position(p));
                 const Float t = dist/radius;
                 if(t < 1.0f) {
                     const Float w = Math::lerp(0.0f, magnitude, t);
-                    _particles.velocities[p] += movingVel * w;
+                    _particles.velocitiesX[p] += movingVel.x()*w;
+                    _particles.velocitiesY[p] += movingVel.y()*w;
                 }
             }
         }
@@ -146,28 +204,63 @@ void ApicSolver2D::advanceFrame(Float frameDuration) {
         else if(frameTime + Float(1.5) * substep > frameDuration)
             substep = remainingTime * Float(0.5);
         frameTime += substep;
+        if(_statistics) ++_statistics->substepCount;
+
+        using Stage = SolverStatistics::Stage;
 
         /* Advect particles */
-        moveParticles(substep);
+        {
+            ScopedStageTimer timer{_statistics, Stage::MoveParticles};
+            moveParticles(substep);
+        }
 
         /* Particles => grid */
-        collectParticlesToCells();
-        particleVelocity2Grid();
+        {
+            ScopedStageTimer timer{_statistics, Stage::Collect};
+            collectParticlesToCells();
+        }
+        {
+            ScopedStageTimer timer{_statistics, Stage::ParticlesToGrid};
+            particleVelocity2Grid();
+        }
 
         /* Update grid velocity */
-        extrapolate(_grid.u, _grid.uTmp, _grid.uValid, _grid.uOldValid);
-        extrapolate(_grid.v, _grid.vTmp, _grid.vValid, _grid.vOldValid);
-        addGravity(substep);
-        computeFluidSDF();
-        solvePressures(substep);
+        {
+            ScopedStageTimer timer{_statistics, Stage::Extrapolate};
+            extrapolate(_grid.u, _grid.uValid, _grid.uBand);
+            extrapolate(_grid.v, _grid.vValid, _grid.vBand);
+        }
+        {
+            ScopedStageTimer timer{_statistics, Stage::Gravity};
+            addGravity(substep);
+        }
+        {
+            ScopedStageTimer timer{_statistics, Stage::FluidSDF};
+            computeFluidSDF();
+        }
+        {
+            ScopedStageTimer timer{_statistics, Stage::Pressure};
+            solvePressures(substep);
+        }
 
         /* Enforce boundary condition */
-        constrainVelocity();
+        {
+            ScopedStageTimer timer{_statistics, Stage::Constrain};
+            constrainVelocity();
+        }
 
         /* Grid => particles */
-        relaxParticlePositions(substep);
-        gridVelocity2Particle();
+        {
+            ScopedStageTimer timer{_statistics, Stage::Relax};
+            relaxParticlePositions(substep);
+        }
+        {
+            ScopedStageTimer timer{_statistics, Stage::GridToParticles};
+            gridVelocity2Particle();
+        }
     }
+
+    cullParticles();
 }
 
 Float ApicSolver2D::timestepCFL() const {
@@ -182,18 +275,37 @@ Float ApicSolver2D::timestepCFL() const {
 }
 
 void ApicSolver2D::moveParticles(Float dt) {
+    /* Plain streaming over the component arrays, vectorizable */
+    Float* const x = _particles.positionsX.data();
+    Float* const y = _particles.positionsY.data();
+    const Float* const vx = _particles.velocitiesX.data();
+    const Float* const vy = _particles.velocitiesY.data();
+    for(UnsignedInt p = 0, pend = _particles.size(); p < pend; ++p) {
+        x[p] += vx[p]*dt;
+        y[p] += vy[p]*dt;
+    }
+
     _particles.loopAll([&](UnsignedInt p) {
-        const Vector2 newPos = _particles.positions[p] + _particles.velocities[p]*dt;
-        _particles.positions[p] = _grid.constrainBoundary(newPos);
+        _particles.setPosition(p, constrainBoundary(_particles.position(p)));
     });
 }
 
+Vector2 ApicSolver2D::constrainBoundary(const Vector2& worldPos) const {
+    const Float sdfVal = _boundaryGrid.signedDistance(worldPos);
+    if(sdfVal < 0) {
+        const Vector2 normal = _boundaryGrid.gradient(worldPos);
+        return worldPos - sdfVal*normal;
+    } else {
+        return worldPos;
+    }
+}
+
 void ApicSolver2D::collectParticlesToCells() {
     _grid.cellParticles.loop1D([&](std::size_t i) {
         _grid.cellParticles.data()[i].resize(0);
     });
     _particles.loopAll([&](UnsignedInt p) {
-        const Vector2 ppos = _particles.positions[p];
+        const Vector2 ppos = _particles.position(p);
         const Vector2i gridCoord = _grid.getValidCellIdx(ppos);
         _grid.cellParticles(gridCoord).push_back(p);
     });
@@ -205,11 +317,11 @@ void ApicSolver2D::particleVelocity2Grid() {
         Float sumU = 0.0f;
         const Vector2 nodePos = _grid.getWorldPos({Float(i), j + 0.5f});
         _grid.loopNeigborParticles(static_cast<Int>(i), static_cast<Int>(j), -1, 0, -1, 1, [&](UnsignedInt p) {
-            const Vector2 xpg = nodePos - _particles.positions[p];
+            const Vector2 xpg = nodePos - _particles.position(p);
             const auto w      = linearKernel(xpg, _grid.invCellSize);
             if(w > 0) {
                 sumW += w;
-                sumU += w*(_particles.velocities[p].x() + Math::dot(_particles.affineMat[p][0], xpg));
+                sumU += w*(_particles.velocitiesX[p] + Math::dot(_particles.affineU(p), xpg));
             }
         });
         _grid.u(i, j) = sumW > 0 ? sumU/sumW : 0.0f;
@@ -221,11 +333,11 @@ void ApicSolver2D::particleVelocity2Grid() {
         Float sumV = 0.0;
         const Vector2 nodePos = _grid.getWorldPos({i + 0.5f, Float(j)});
         _grid.loopNeigborParticles(static_cast<Int>(i), static_cast<Int>(j), -1, 1, -1, 0, [&](UnsignedInt p) {
-            const Vector2 xpg = nodePos - _particles.positions[p];
+            const Vector2 xpg = nodePos - _particles.position(p);
             const auto w      = linearKernel(xpg, _grid.invCellSize);
             if(w > 0) {
                 sumW += w;
-                sumV += w*(_particles.velocities[p].y() + Math::dot(_particles.affineMat[p][1], xpg));
+                sumV += w*(_particles.velocitiesY[p] + Math::dot(_particles.affineV(p), xpg));
             }
         });
         _grid.v(i, j) = sumW > 0 ? sumV/sumW : 0.0f;
@@ -233,47 +345,108 @@ void ApicSolver2D::particleVelocity2Grid() {
     });
 }
 
-void ApicSolver2D::extrapolate(Array2X<Float>& grid, Array2X<Float>& tmp_grid, Array2X<char>& valid, Array2X<char>& old_valid) const {
-    tmp_grid  = grid;
-    old_valid = valid;
+void ApicSolver2D::extrapolate(Array2X<Float>& grid, Array2X<char>& valid, ExtrapolationBand& band) const {
+    const std::size_t sizeX = grid.sizeX();
+    Float* const values = grid.data();
+    char* const flags = valid.data();
+    char* const inFront = band.inFront.data();
+
+    /* Seed the front with invalid faces next to valid ones. Faces
+       extrapolated in layer N are then marked with N + 2 in the valid array,
+       which keeps them non-zero for the rest of the solver and lets the next
+       front be found only around the faces from the previous layer. */
+    TaskScheduler::forEach(band.tileCount(), [&](std::size_t tile) {
+        std::vector<UnsignedInt>& front = band.fronts[tile];
+        front.clear();
+
+        Vector2i begin, end;
+        band.tileRange(tile, begin, end);
+        for(Int j = begin.y(); j < end.y(); ++j) {
+            for(Int i = begin.x(); i < end.x(); ++i) {
+                const std::size_t idx = i + sizeX*j;
+                if(!flags[idx] && (flags[idx - 1] || flags[idx + 1] ||
+                   flags[idx - sizeX] || flags[idx + sizeX]))
+                    front.push_back(UnsignedInt(idx));
+            }
+        }
+    });
 
-    Array2X<Float>* pgrids[] = {&grid, &tmp_grid};
-    Array2X<char>* pvalids[] = {&valid, &old_valid};
+    for(UnsignedInt layer = 0; layer < _extrapolationLayers; ++layer) {
+        const char mark = char(layer + 2);
+
+        /* Average of the neighbors valid before this layer. Faces on the
+           front are still invalid while this runs, so the tiles don't see
+           each other's results. */
+        TaskScheduler::forEach(band.tileCount(), [&](std::size_t tile) {
+            for(const UnsignedInt idx: band.fronts[tile]) {
+                const std::size_t neighbors[] = { idx + 1, idx - 1, idx + sizeX, idx - sizeX };
+
+                Float sum = 0;
+                Int count = 0;
+                for(std::size_t n: neighbors) {
+                    if(flags[n]) {
+                        sum += values[n];
+                        ++count;
+                    }
+                }
 
-    for(int layers = 0; layers < 1; ++layers) {
-        auto& gridSrc = *pgrids[layers & 1];
-        auto& gridTgt = *pgrids[!(layers & 1)];
+                CORRADE_INTERNAL_ASSERT(count > 0);
+                values[idx] = sum/Float(count);
+            }
+        });
 
-        auto& validSrc = *pvalids[layers & 1];
-        auto& validTgt = *pvalids[!(layers & 1)];
+        TaskScheduler::forEach(band.tileCount(), [&](std::size_t tile) {
+            for(const UnsignedInt idx: band.fronts[tile]) {
+                flags[idx] = mark;
+                inFront[idx] = 0;
+            }
+        });
 
-        grid.loop2D([&](std::size_t i, std::size_t j) {
-            if(i == 0 || i == grid.sizeX() - 1 ||
-               j == 0 || j == grid.sizeY() - 1) return;
+        if(layer + 1 == _extrapolationLayers) break;
 
-            Float sum = 0;
-            Int count = 0;
+        /* Next front, each tile collects only faces it owns -- invalid
+           neighbors of its own front and faces on its border touching the
+           front of an adjacent tile */
+        TaskScheduler::forEach(band.tileCount(), [&](std::size_t tile) {
+            std::vector<UnsignedInt>& next = band.nextFronts[tile];
+            next.clear();
 
-            if(!validSrc(i, j)) {
-                const std::size_t rows[] = { i + 1, i - 1, i, i };
-                const std::size_t cols[] = { j, j, j + 1, j - 1 };
+            Vector2i begin, end;
+            band.tileRange(tile, begin, end);
+            const auto owned = [&](std::size_t idx) {
+                const Int i = Int(idx%sizeX), j = Int(idx/sizeX);
+                return i >= begin.x() && i < end.x() && j >= begin.y() && j < end.y();
+            };
+            const auto add = [&](std::size_t idx) {
+                if(flags[idx] || inFront[idx]) return;
+                inFront[idx] = 1;
+                next.push_back(UnsignedInt(idx));
+            };
 
-                for(std::size_t cell = 0; cell < 4; ++cell) {
-                    if(validSrc(rows[cell], cols[cell])) {
-                        sum += gridSrc(rows[cell], cols[cell]);
-                        ++count;
-                    }
-                }
+            for(const UnsignedInt idx: band.fronts[tile]) {
+                const std::size_t neighbors[] = { idx + 1, idx - 1, idx + sizeX, idx - sizeX };
+                for(std::size_t n: neighbors)
+                    if(owned(n)) add(n);
+            }
 
-                if(count > 0) {
-                    gridTgt(i, j) = sum/Float(count);
-                    validTgt(i, j) = 1;
-                }
+            const auto addBorder = [&](Int i, Int j) {
+                const std::size_t idx = i + sizeX*j;
+                if(flags[idx - 1] == mark || flags[idx + 1] == mark ||
+                   flags[idx - sizeX] == mark || flags[idx + sizeX] == mark)
+                    add(idx);
+            };
+            if(begin.x() >= end.x() || begin.y() >= end.y()) return;
+            for(Int i = begin.x(); i < end.x(); ++i) {
+                addBorder(i, begin.y());
+                addBorder(i, end.y() - 1);
+            }
+            for(Int j = begin.y() + 1; j < end.y() - 1; ++j) {
+                addBorder(begin.x(), j);
+                addBorder(end.x() - 1, j);
             }
         });
 
-        gridSrc.swapContent(gridTgt);
-        validSrc.swapContent(validTgt);
+        std::swap(band.fronts, band.nextFronts);
     }
 }
 
@@ -289,7 +462,7 @@ void ApicSolver2D::computeFluidSDF() {
     _grid.fluidSDF.assign(3 * _grid.cellSize);
 
     _particles.loopAll([&](UnsignedInt p) {
-        const Vector2 ppos = _particles.positions[p];
+        const Vector2 ppos = _particles.position(p);
         const Vector2i gridPos = Vector2i(_grid.getGridPos(ppos) - Vector2(0.5));
 
         for(Int j = gridPos.y() - 2; j <= gridPos.y() + 2; ++j) {
@@ -304,11 +477,10 @@ void ApicSolver2D::computeFluidSDF() {
         }
     });
 
-    _grid.fluidSDF.loop2D([&](std::size_t i, std::size_t j) {
-        const Vector2 cellCenter = _grid.getWorldPos({i + 0.5f, j + 0.5f});
-        const Float sdfVal = _objects->boundary.signedDistance(cellCenter);
-        if(_grid.fluidSDF(i, j) > sdfVal)
-            _grid.fluidSDF(i, j) = sdfVal;
+    /* The boundary doesn't move, so its distance at cell centers is
+       precomputed in initBoundary() */
+    _grid.fluidSDF.loop1D([&](std::size_t i) {
+        _grid.fluidSDF.data()[i] = Math::min(_grid.fluidSDF.data()[i], _grid.boundaryCellSDF.data()[i]);
     });
 }
 
@@ -374,7 +546,15 @@ void ApicSolver2D::solvePressures(Float dt) {
         }
     }
 
-    _pressureSolver.solve(); /* now solve the linear system for cells' pressure */
+    /* Now solve the linear system for cells' pressure */
+    const bool converged = _pressureSolver.solve();
+    if(_statistics) {
+        const UnsignedInt iterations = _pressureSolver.pcgSolver.lastIterationCount();
+        _statistics->pcgIterations += iterations;
+        _statistics->pcgMaxIterations = Math::max(_statistics->pcgMaxIterations, iterations);
+        _statistics->pcgMaxResidual = Math::max(_statistics->pcgMaxResidual, Double(_pressureSolver.pcgSolver.lastResidual()));
+        if(!converged) ++_statistics->pcgFailures;
+    }
 
     _grid.u.loop2D([&](std::size_t i, std::size_t j) {
         /* Edges of the domain, or entirely in solid */
@@ -426,7 +606,7 @@ void ApicSolver2D::constrainVelocity() {
             return;
 
         const Vector2 gridPos = Vector2(i, j + 0.5f);
-        const Vector2 normal = _grid.boundarySDF.interpolateGradient(gridPos);
+        const Vector2 normal = _boundaryGrid.gradient(_grid.getWorldPos(gridPos));
         Vector2 vel = _grid.velocityFromGridPos(gridPos);
         Float perp_component = Math::dot(vel, normal);
         vel -= perp_component*normal;
@@ -438,7 +618,7 @@ void ApicSolver2D::constrainVelocity() {
             return;
 
         const Vector2 gridPos = Vector2(i + 0.5f, j);
-        const Vector2 normal  = _grid.boundarySDF.interpolateGradient(gridPos);
+        const Vector2 normal = _boundaryGrid.gradient(_grid.getWorldPos(gridPos));
         Vector2 vel = _grid.velocityFromGridPos(gridPos);
         Float perp_component = Math::dot(vel, normal);
         vel -= perp_component*normal;
@@ -458,14 +638,14 @@ void ApicSolver2D::relaxParticlePositions(Float dt) {
     constexpr Float stiffness = 5.0f;
 
     _particles.loopAll([&](UnsignedInt p) {
-        const Vector2 ppos = _particles.positions[p];
+        const Vector2 ppos = _particles.position(p);
         const Vector2i gridCoord = _grid.getValidCellIdx(ppos);
         Vector2 spring = Vector2{0.0f};
 
         _grid.loopNeigborParticles(gridCoord.x(), gridCoord.y(), -1, 1, -1, 1, [&](UnsignedInt q) {
             if(p == q) return;
 
-            const Vector2 xpq  = ppos - _particles.positions[q];
+            const Vector2 xpq  = ppos - _particles.position(q);
             const auto distSqr = xpq.dot();
             const auto w       = stiffness*smoothKernel(distSqr, restDistSqr);
             if(distSqr > overlappedSqr) {
@@ -477,10 +657,13 @@ void ApicSolver2D::relaxParticlePositions(Float dt) {
         });
 
         const Vector2 newPos = ppos + dt*spring;
-        _particles.tmp[p] = _grid.constrainBoundary(newPos);
+        const Vector2 constrainedPos = constrainBoundary(newPos);
+        _particles.tmpX[p] = constrainedPos.x();
+        _particles.tmpY[p] = constrainedPos.y();
     });
 
-    _particles.positions.swap(_particles.tmp);
+    _particles.positionsX.swap(_particles.tmpX);
+    _particles.positionsY.swap(_particles.tmpY);
 }
 
 void ApicSolver2D::gridVelocity2Particle() {
@@ -489,14 +672,14 @@ void ApicSolver2D::gridVelocity2Particle() {
     const auto dxInv = _grid.invCellSize;
 
     _particles.loopAll([&](UnsignedInt p) {
-        const Vector2 gridPos = _grid.getGridPos(_particles.positions[p]);
+        const Vector2 gridPos = _grid.getGridPos(_particles.position(p));
         const Vector2 px = gridPos - Vector2(0, 0.5);
         const Vector2 py = gridPos - Vector2(0.5, 0);
 
-        _particles.velocities[p] = Vector2(u.interpolateValue(px),
-                                           v.interpolateValue(py));
-        _particles.affineMat[p] = Matrix2x2(u.affineInterpolateValue(px)*dxInv,
-                                            v.affineInterpolateValue(py)*dxInv);
+        _particles.velocitiesX[p] = u.interpolateValue(px);
+        _particles.velocitiesY[p] = v.interpolateValue(py);
+        _particles.setAffine(p, u.affineInterpolateValue(px)*dxInv,
+                                v.affineInterpolateValue(py)*dxInv);
     });
 }
 
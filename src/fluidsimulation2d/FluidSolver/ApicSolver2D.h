@@ -33,7 +33,10 @@
 
 #include <Corrade/Containers/Pointer.h>
 
+#include "DataStructures/SDFGrid.h"
+#include "DataStructures/SDFProgram.h"
 #include "FluidSolver/SolverData.h"
+#include "FluidSolver/SolverStatistics.h"
 
 namespace Magnum { namespace Examples {
 
@@ -46,9 +49,32 @@ public:
     void reset() {
         _particles.reset();
         _particles.addParticles(_particles.positionsT0, 0);
+        _removedParticleCount = 0;
     }
 
-    void emitParticles() { generateParticles(_objects->emitter, 10); }
+    void emitParticles();
+
+    /* Only the part of the baked emitter around the old and new position is
+       evaluated again on next emission */
+    void moveEmitter(const Vector2& offset) {
+        _emitterGrid.markDirty(_emitterProgram.translate(offset));
+    }
+
+    /* World-space bounds of the emitter primitives */
+    Range2D emitterBounds() const { return _emitterProgram.bounds(); }
+
+    /* Count of emitter grid nodes evaluated again by the last emission */
+    UnsignedInt rebakedEmitterNodeCount() const { return _rebakedEmitterNodeCount; }
+
+    /* Removes particles outside of the domain and the ones not passing the
+       culling policy. Called at the end of every advanceFrame() and after
+       each emission, returns count of removed particles. */
+    UnsignedInt cullParticles();
+
+    ParticleCulling& particleCulling() { return _culling; }
+
+    /* Total count of particles removed since last reset */
+    UnsignedInt removedParticleCount() const { return _removedParticleCount; }
 
     void addRepulsiveVelocity(const Vector2& p0, const Vector2& p1, Float dt, Float radius, Float magnitude);
 
@@ -59,21 +85,43 @@ public:
 
     Float particleRadius() const { return _particles.particleRadius; }
 
-    const std::vector<Vector2>& particlePositions() const {
-        return _particles.positions;
+    const AlignedArray<Float>& particlePositionsX() const {
+        return _particles.positionsX;
     }
 
+    const AlignedArray<Float>& particlePositionsY() const {
+        return _particles.positionsY;
+    }
+
+    /* Count of face layers the grid velocity is extrapolated into around
+       the fluid. Particles can move up to three cells per substep, larger
+       values make sure they don't end up sampling zero velocity. */
+    UnsignedInt extrapolationLayers() const { return _extrapolationLayers; }
+    void setExtrapolationLayers(UnsignedInt layers) {
+        /* extrapolate() marks faces of each layer with the layer index + 2
+           in a char array, which has to fit into a signed char */
+        CORRADE_INTERNAL_ASSERT(layers >= 1 && layers <= 120);
+        _extrapolationLayers = layers;
+    }
+
+    /* If set, advanceFrame() accumulates per-stage timings and pressure
+       solver convergence into it. Not owned by the solver. */
+    SolverStatistics* statistics() const { return _statistics; }
+    void setStatistics(SolverStatistics* statistics) { _statistics = statistics; }
+
 private:
     /* Initialization */
     void initBoundary();
-    void generateParticles(const SDFObject& sdfObj, Float initialVelocity_y);
+    /* Projects a position in the solid back onto the boundary surface */
+    Vector2 constrainBoundary(const Vector2& worldPos) const;
+    template<class SignedDistance> void generateParticles(const SignedDistance& sdf, Float initialVelocity_y);
 
     /* Simulation */
     Float timestepCFL() const;
     void moveParticles(Float dt);
     void collectParticlesToCells();
     void particleVelocity2Grid();
-    void extrapolate(Array2X<Float>& grid, Array2X<Float>& tmp_grid, Array2X<char>& valid, Array2X<char>& old_valid) const;
+    void extrapolate(Array2X<Float>& grid, Array2X<char>& valid, ExtrapolationBand& band) const;
     void addGravity(Float dt);
     void computeFluidSDF();
     void solvePressures(Float dt);
@@ -84,7 +132,20 @@ private:
     Containers::Pointer<SceneObjects> _objects;
     ParticleData _particles;
     GridData _grid;
+    SDFProgram _boundaryProgram;
+    SDFProgram _emitterProgram;
+    /* Static, so baked in the whole domain with analytic gradients used as
+       boundary normals */
+    SDFGrid _boundaryGrid;
+    SDFGrid _emitterGrid;
+    UnsignedInt _rebakedEmitterNodeCount = 0;
     LinearSystemSolver _pressureSolver;
+    SolverStatistics* _statistics = nullptr;
+    UnsignedInt _extrapolationLayers = 1;
+
+    ParticleCulling _culling;
+    AlignedArray<UnsignedByte> _keepParticles;
+    UnsignedInt _removedParticleCount = 0;
 };
 
 }}
@@ -34,9 +34,11 @@
 #include <vector>
 #include <Magnum/Math/Matrix.h>
 
+#include "DataStructures/AlignedArray.h"
 #include "DataStructures/Array2X.h"
 #include "DataStructures/SDFObject.h"
 #include "DataStructures/PCGSolver.h"
+#include "TaskScheduler.h"
 
 namespace Magnum { namespace Examples {
 struct SceneObjects {
@@ -45,26 +47,149 @@ struct SceneObjects {
     SDFObject boundary;  /* solid boundary */
 };
 
+/* Particles outside of the grid domain are always removed, the rest is
+   optional */
+struct ParticleCulling {
+    /* If enabled, particles for which dot(position, killPlaneNormal) is less
+       than killPlaneOffset are removed */
+    bool killPlane = false;
+    Vector2 killPlaneNormal{0.0f, 1.0f};
+    Float killPlaneOffset = 0.0f;
+
+    /* If non-zero, particles with lowest indices (which are the oldest ones
+       with stable ordering) are removed to fit the budget */
+    UnsignedInt maxParticleCount = 0;
+
+    /* Stable removal preserves relative order of the remaining particles,
+       otherwise the holes are filled from the back, which moves less data
+       but reorders the particles */
+    bool stableOrder = true;
+};
+
+/* Particle data are stored as structure of arrays, with separate x and y
+   components, so the loops over them can be vectorized */
 struct ParticleData {
     explicit ParticleData(Float cellSize) : particleRadius{cellSize* 0.5f} {}
 
-    UnsignedInt size() const { return static_cast<UnsignedInt>(positions.size()); }
+    UnsignedInt size() const { return static_cast<UnsignedInt>(positionsX.size()); }
+    std::size_t capacity() const { return positionsX.capacity(); }
+
+    Vector2 position(UnsignedInt p) const { return {positionsX[p], positionsY[p]}; }
+    void setPosition(UnsignedInt p, const Vector2& position) {
+        positionsX[p] = position.x();
+        positionsY[p] = position.y();
+    }
+
+    Vector2 velocity(UnsignedInt p) const { return {velocitiesX[p], velocitiesY[p]}; }
+    void setVelocity(UnsignedInt p, const Vector2& velocity) {
+        velocitiesX[p] = velocity.x();
+        velocitiesY[p] = velocity.y();
+    }
+
+    /* Columns of the APIC affine matrix, i.e. gradients of the u and v
+       velocity components */
+    Vector2 affineU(UnsignedInt p) const { return {affineUX[p], affineUY[p]}; }
+    Vector2 affineV(UnsignedInt p) const { return {affineVX[p], affineVY[p]}; }
+    void setAffine(UnsignedInt p, const Vector2& u, const Vector2& v) {
+        affineUX[p] = u.x();
+        affineUY[p] = u.y();
+        affineVX[p] = v.x();
+        affineVY[p] = v.y();
+    }
+
+    void reserve(std::size_t capacity) {
+        loopArrays([&](AlignedArray<Float>& array) { array.reserve(capacity); });
+    }
 
     void addParticles(const std::vector<Vector2>& newParticles, Float initialVelocity_y) {
         if(positionsT0.size() == 0) {
             positionsT0 = newParticles;
         }
-        positions.insert(positions.end(), newParticles.begin(), newParticles.end());
-        velocities.resize(size(), Vector2(0, -initialVelocity_y));
-        affineMat.resize(size(), Matrix2x2(0));
-        tmp.resize(size(), Vector2(0));
+
+        /* The arrays grow geometrically, so repeated emission doesn't
+           reallocate every time */
+        const UnsignedInt oldSize = size();
+        const std::size_t newSize = oldSize + newParticles.size();
+        loopArrays([&](AlignedArray<Float>& array) { array.resize(newSize, 0.0f); });
+        for(std::size_t i = 0; i != newParticles.size(); ++i) {
+            positionsX[oldSize + i] = newParticles[i].x();
+            positionsY[oldSize + i] = newParticles[i].y();
+            velocitiesY[oldSize + i] = -initialVelocity_y;
+        }
     }
 
+    /* Moves the last particle into the removed slot */
+    void removeParticle(UnsignedInt p) {
+        loopArrays([&](AlignedArray<Float>& array) { array.swapRemove(p); });
+    }
+
+    /* Removes all particles for which keep[p] is zero, returns count of
+       removed particles */
+    UnsignedInt compact(const AlignedArray<UnsignedByte>& keep, bool stable) {
+        CORRADE_INTERNAL_ASSERT(keep.size() == size());
+        return stable ? compactStable(keep) : compactUnstable(keep);
+    }
+
+    /* Parallel stream compaction -- count kept particles per chunk, turn
+       the counts into output offsets and then scatter each chunk into its
+       place, using the temporary arrays as the destination */
+    UnsignedInt compactStable(const AlignedArray<UnsignedByte>& keep) {
+        constexpr std::size_t ChunkSize = 4096;
+        const std::size_t count = size();
+        const std::size_t chunkCount = (count + ChunkSize - 1)/ChunkSize;
+        chunkOffsets.assign(chunkCount + 1, 0);
+
+        TaskScheduler::forEach(chunkCount, [&](std::size_t chunk) {
+            UnsignedInt kept = 0;
+            for(std::size_t p = chunk*ChunkSize, pend = Math::min(p + ChunkSize, count); p < pend; ++p)
+                kept += keep[p] ? 1 : 0;
+            chunkOffsets[chunk + 1] = kept;
+        });
+        for(std::size_t chunk = 0; chunk != chunkCount; ++chunk)
+            chunkOffsets[chunk + 1] += chunkOffsets[chunk];
+
+        const std::size_t newSize = chunkOffsets[chunkCount];
+        if(newSize == count) return 0;
+
+        AlignedArray<Float>* arrays[]{
+            &positionsX, &positionsY,
+            &velocitiesX, &velocitiesY,
+            &affineUX, &affineUY, &affineVX, &affineVY
+        };
+        for(AlignedArray<Float>* array: arrays) {
+            tmpX.resize(newSize);
+            const Float* const src = array->data();
+            Float* const dst = tmpX.data();
+            TaskScheduler::forEach(chunkCount, [&](std::size_t chunk) {
+                UnsignedInt out = chunkOffsets[chunk];
+                for(std::size_t p = chunk*ChunkSize, pend = Math::min(p + ChunkSize, count); p < pend; ++p)
+                    if(keep[p]) dst[out++] = src[p];
+            });
+
+            /* The original array becomes the scratch space for the next one */
+            array->swap(tmpX);
+        }
+
+        tmpX.resize(newSize);
+        tmpY.resize(newSize);
+        return UnsignedInt(count - newSize);
+    }
+
+    /* Going from the back, so the particle moved into a removed slot is
+       always one that's known to be kept */
+    UnsignedInt compactUnstable(const AlignedArray<UnsignedByte>& keep) {
+        UnsignedInt removed = 0;
+        for(UnsignedInt p = size(); p-- > 0; ) {
+            if(keep[p]) continue;
+            removeParticle(p);
+            ++removed;
+        }
+        return removed;
+    }
+
+    /* Keeps the allocated capacity */
     void reset() {
-        positions.resize(0);
-        velocities.resize(0);
-        affineMat.resize(0);
-        tmp.resize(0);
+        loopArrays([&](AlignedArray<Float>& array) { array.clear(); });
     }
 
     template<class Function>
@@ -74,12 +199,63 @@ struct ParticleData {
         }
     }
 
-    const Float            particleRadius;
-    std::vector<Vector2>   positionsT0;
-    std::vector<Vector2>   positions;
-    std::vector<Vector2>   velocities;
-    std::vector<Matrix2x2> affineMat;
-    std::vector<Vector2>   tmp;
+    template<class Function> void loopArrays(Function&& func) {
+        AlignedArray<Float>* arrays[]{
+            &positionsX, &positionsY,
+            &velocitiesX, &velocitiesY,
+            &affineUX, &affineUY, &affineVX, &affineVY,
+            &tmpX, &tmpY
+        };
+        for(AlignedArray<Float>* array: arrays) func(*array);
+    }
+
+    const Float          particleRadius;
+    std::vector<Vector2> positionsT0;
+    AlignedArray<Float>  positionsX, positionsY;
+    AlignedArray<Float>  velocitiesX, velocitiesY;
+    AlignedArray<Float>  affineUX, affineUY, affineVX, affineVY;
+    AlignedArray<Float>  tmpX, tmpY;
+
+    /* Scratch space for compaction */
+    std::vector<UnsignedInt> chunkOffsets;
+};
+
+/* Narrow band of faces for multi-layer velocity extrapolation. The grid is
+   split into square tiles and each tile keeps its own list of faces on the
+   extrapolation front (as linear indices into the face grid), so the tiles
+   can be processed in parallel, each writing only into faces it owns */
+struct ExtrapolationBand {
+    enum: std::size_t { TileSize = 32 };
+
+    void resize(std::size_t sizeX_, std::size_t sizeY_) {
+        sizeX = sizeX_;
+        sizeY = sizeY_;
+        tilesX = (sizeX + TileSize - 1)/TileSize;
+        tilesY = (sizeY + TileSize - 1)/TileSize;
+        fronts.resize(tilesX*tilesY);
+        nextFronts.resize(tilesX*tilesY);
+        inFront.resize(sizeX, sizeY, 0);
+    }
+
+    std::size_t tileCount() const { return fronts.size(); }
+
+    /* Range of faces owned by given tile, excluding the outermost layer of
+       the grid, which is never extrapolated into */
+    void tileRange(std::size_t tile, Vector2i& begin, Vector2i& end) const {
+        const std::size_t ti = tile%tilesX, tj = tile/tilesX;
+        begin = {Int(Math::max(ti*TileSize, std::size_t(1))),
+                 Int(Math::max(tj*TileSize, std::size_t(1)))};
+        end = {Int(Math::min((ti + 1)*TileSize, sizeX - 1)),
+               Int(Math::min((tj + 1)*TileSize, sizeY - 1))};
+    }
+
+    std::size_t sizeX = 0, sizeY = 0;
+    std::size_t tilesX = 0, tilesY = 0;
+    std::vector<std::vector<UnsignedInt>> fronts, nextFronts;
+
+    /* Deduplicates faces while building the next front, only ever touched by
+       the tile owning the face */
+    Array2X<char> inFront;
 };
 
 struct GridData {
@@ -96,11 +272,11 @@ struct GridData {
         vWeights.resize(nI, nJ + 1);
         uValid.resize(nI + 1, nJ);
         vValid.resize(nI, nJ + 1);
-        uOldValid.resize(nI + 1, nJ);
-        vOldValid.resize(nI, nJ + 1);
+        uBand.resize(nI + 1, nJ);
+        vBand.resize(nI, nJ + 1);
 
         fluidSDF.resize(nI, nJ);
-        boundarySDF.resize(nI + 1, nJ + 1);
+        boundaryCellSDF.resize(nI, nJ);
         cellParticles.resize(nI, nJ);
     }
 
@@ -131,17 +307,6 @@ struct GridData {
                        v.interpolateValue(py));
     }
 
-    Vector2 constrainBoundary(const Vector2& worldPos) const {
-        const Vector2 gridPos = getGridPos(worldPos);
-        const Float sdfVal = boundarySDF.interpolateValue(gridPos);
-        if(sdfVal < 0) {
-            const Vector2 normal = boundarySDF.interpolateGradient(gridPos);
-            return worldPos - sdfVal*normal;
-        } else {
-            return worldPos;
-        }
-    }
-
     template<class Function> void loopNeigborParticles(Int i, Int j, Int il, Int ih, Int jl, Int jh, Function&& func) const {
         for(Int sj = j + jl; sj <= j + jh; ++sj) {
             for(Int si = i + il; si <= i + ih; ++si) {
@@ -165,8 +330,9 @@ struct GridData {
     /* Nodes and cells' data */
     Array2X<Float> u, uTmp, uWeights;
     Array2X<Float> v, vTmp, vWeights;
-    Array2X<char> uValid, vValid, uOldValid, vOldValid;
-    Array2X<Float> boundarySDF;
+    Array2X<char> uValid, vValid;
+    ExtrapolationBand uBand, vBand;
+    Array2X<Float> boundaryCellSDF; /* boundary SDF sampled at cell centers */
     Array2X<Float> fluidSDF;
 
     Array2X<std::vector<UnsignedInt>> cellParticles;
@@ -184,10 +350,12 @@ struct LinearSystemSolver {
         solution.assign(solution.size(), 0);
     }
 
-    void solve() {
+    bool solve() {
         if(!pcgSolver.solve(matrix, rhs, solution)) {
             Error{} << "Pressure solve failed!";
+            return false;
         }
+        return true;
     }
 
     /* Use double for linear system (the solver converges slower if using float
@@ -0,0 +1,125 @@
+#ifndef Magnum_Examples_FluidSimulation2D_SolverStatistics_h
+#define Magnum_Examples_FluidSimulation2D_SolverStatistics_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2019 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <chrono>
+#include <Magnum/Magnum.h>
+
+namespace Magnum { namespace Examples {
+
+/* Per-stage timings and pressure solver convergence, accumulated over all
+   substeps of advanceFrame() if attached to the solver */
+struct SolverStatistics {
+    enum class Stage: UnsignedInt {
+        MoveParticles,
+        Collect,
+        ParticlesToGrid,
+        Extrapolate,
+        Gravity,
+        FluidSDF,
+        Pressure,
+        Constrain,
+        Relax,
+        GridToParticles,
+        Cull
+    };
+
+    enum: UnsignedInt { StageCount = UnsignedInt(Stage::Cull) + 1 };
+
+    static const char* stageName(Stage stage) {
+        switch(stage) {
+            case Stage::MoveParticles: return "moveParticles";
+            case Stage::Collect: return "collect";
+            case Stage::ParticlesToGrid: return "P2G";
+            case Stage::Extrapolate: return "extrapolate";
+            case Stage::Gravity: return "gravity";
+            case Stage::FluidSDF: return "SDF";
+            case Stage::Pressure: return "pressure";
+            case Stage::Constrain: return "constrain";
+            case Stage::Relax: return "relax";
+            case Stage::GridToParticles: return "G2P";
+            case Stage::Cull: return "cull";
+        }
+
+        return "";
+    }
+
+    void reset() { *this = SolverStatistics{}; }
+
+    Double totalDuration() const {
+        Double sum = 0.0;
+        for(Double duration: stageDurations) sum += duration;
+        return sum;
+    }
+
+    /* Seconds spent in each stage */
+    Double stageDurations[StageCount]{};
+
+    UnsignedInt substepCount = 0;
+
+    /* Particles removed by ApicSolver2D::cullParticles() */
+    UnsignedInt removedParticles = 0;
+
+    /* Pressure solver iterations summed over all substeps, max per substep,
+       max residual after a solve and count of solves that didn't converge */
+    UnsignedInt pcgIterations = 0;
+    UnsignedInt pcgMaxIterations = 0;
+    Double pcgMaxResidual = 0.0;
+    UnsignedInt pcgFailures = 0;
+};
+
+/* Adds time spent in the current scope to given stage. Does nothing if the
+   statistics pointer is null. */
+class ScopedStageTimer {
+    public:
+        explicit ScopedStageTimer(SolverStatistics* statistics, SolverStatistics::Stage stage): _statistics{statistics}, _stage{stage} {
+            if(_statistics) _start = std::chrono::steady_clock::now();
+        }
+
+        ScopedStageTimer(const ScopedStageTimer&) = delete;
+        ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+        ~ScopedStageTimer() {
+            if(!_statistics) return;
+            _statistics->stageDurations[UnsignedInt(_stage)] +=
+                std::chrono::duration<Double>(std::chrono::steady_clock::now() - _start).count();
+        }
+
+    private:
+        SolverStatistics* _statistics;
+        SolverStatistics::Stage _stage;
+        std::chrono::steady_clock::time_point _start;
+};
+
+}}
+
+#endif
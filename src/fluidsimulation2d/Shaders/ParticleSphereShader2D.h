@@ -37,6 +37,10 @@ namespace Magnum { namespace Examples {
 
 class ParticleSphereShader2D: public GL::AbstractShaderProgram {
     public:
+        /* Particle positions come in separate component arrays */
+        typedef GL::Attribute<0, Float> PositionX;
+        typedef GL::Attribute<1, Float> PositionY;
+
         enum ColorMode {
             UniformDiffuseColor = 0,
             RampColorById
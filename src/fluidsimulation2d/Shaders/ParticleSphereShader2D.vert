@@ -38,7 +38,8 @@ uniform float particleRadius;
 uniform vec3 uniformColor;
 
 
-layout(location = 0) in highp vec2 position;
+layout(location = 0) in highp float positionX;
+layout(location = 1) in highp float positionY;
 flat out vec3 color;
 
 const vec3 colorRamp[] = vec3[] (
@@ -67,5 +68,5 @@ vec3 generateVertexColor() {
 void main() {
     color = generateVertexColor();
     gl_PointSize = particleRadius * float(screenHeight) / float(domainHeight);
-    gl_Position = mat4(viewProjectionMatrix) * vec4(position, 0, 1.0);
+    gl_Position = mat4(viewProjectionMatrix) * vec4(positionX, positionY, 0, 1.0);
 }
@@ -0,0 +1,150 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2019 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstdio>
+#include <Corrade/Containers/Pointer.h>
+#include <Corrade/Utility/Arguments.h>
+#include <Corrade/Utility/Format.h>
+
+#include "DefaultScene.h"
+#include "FluidSolver/ApicSolver2D.h"
+
+using namespace Magnum;
+using namespace Magnum::Examples;
+
+int main(int argc, char** argv) {
+    Utility::Arguments args;
+    args.addOption("frames", "1200")
+            .setHelp("frames", "number of frames to simulate", "COUNT")
+        .addOption("speed", "2.0")
+            .setHelp("speed", "simulation speed, same as in the interactive example", "SPEED")
+        .addOption("output", "fluidsimulation2d-benchmark.csv")
+            .setHelp("output", "per-frame statistics output", "FILE.csv")
+        .addBooleanOption("no-emit")
+            .setHelp("no-emit", "don't emit particles automatically")
+        .addOption("max-particles", "0")
+            .setHelp("max-particles", "particle budget, 0 for unlimited", "COUNT")
+        .addBooleanOption("unstable-removal")
+            .setHelp("unstable-removal", "don't preserve particle order when removing them")
+        .addOption("extrapolation-layers", "1")
+            .setHelp("extrapolation-layers", "count of face layers to extrapolate grid velocity into", "COUNT")
+        .setGlobalHelp("Runs the 2D fluid simulation scene without a window and "
+            "reports time spent in each stage of the solver.")
+        .parse(argc, argv);
+
+    const UnsignedInt frameCount = args.value<UnsignedInt>("frames");
+    const Float speed = args.value<Float>("speed");
+    const bool autoEmit = !args.isSet("no-emit");
+
+    const auto output = args.value("output");
+    std::FILE* csv = std::fopen(output.data(), "w");
+    if(!csv) {
+        Error{} << "Can't open" << output.data() << "for writing";
+        return 1;
+    }
+
+    Utility::formatInto(csv, "frame,particles,removed,substeps");
+    for(UnsignedInt stage = 0; stage != SolverStatistics::StageCount; ++stage)
+        Utility::formatInto(csv, ",{}_ms", SolverStatistics::stageName(SolverStatistics::Stage(stage)));
+    Utility::formatInto(csv, ",total_ms,pcg_iterations,pcg_max_iterations,pcg_max_residual,pcg_failures\n");
+
+    ApicSolver2D solver{GridStart, GridCellLength, NumGridCells.x(), NumGridCells.y(), createDefaultSceneObjects()};
+    SolverStatistics statistics;
+    SolverStatistics totals;
+    solver.setStatistics(&statistics);
+    solver.particleCulling().maxParticleCount = args.value<UnsignedInt>("max-particles");
+    solver.particleCulling().stableOrder = !args.isSet("unstable-removal");
+    solver.setExtrapolationLayers(args.value<UnsignedInt>("extrapolation-layers"));
+
+    /* Same timing as in the interactive example, except that the initial pause
+       is skipped */
+    constexpr Float FrameTime = 1.0f/60.0f;
+    Float evolvedTime = SimulationStartTime;
+    Float lastEmitTime = -1.0f;
+    Int emissionCount = 0;
+
+    for(UnsignedInt frame = 0; frame != frameCount; ++frame) {
+        statistics.reset();
+        solver.advanceFrame(FrameTime*speed);
+        evolvedTime += FrameTime;
+
+        /* Emit particles automatically. Done before writing the statistics
+           so particles culled due to the budget get included. */
+        if(autoEmit && evolvedTime > AutoEmitStartTime) {
+            if(lastEmitTime < 0.0f) lastEmitTime = evolvedTime;
+            if(evolvedTime - lastEmitTime > AutoEmitInterval &&
+               emissionCount < AutoEmitCount)
+            {
+                solver.emitParticles();
+                lastEmitTime = evolvedTime;
+                ++emissionCount;
+            }
+        }
+
+        Utility::formatInto(csv, "{},{},{},{}", frame, solver.numParticles(), statistics.removedParticles, statistics.substepCount);
+        for(UnsignedInt stage = 0; stage != SolverStatistics::StageCount; ++stage) {
+            Utility::formatInto(csv, ",{:.4f}", statistics.stageDurations[stage]*1000.0);
+            totals.stageDurations[stage] += statistics.stageDurations[stage];
+        }
+        Utility::formatInto(csv, ",{:.4f},{},{},{},{}\n",
+            statistics.totalDuration()*1000.0,
+            statistics.pcgIterations,
+            statistics.pcgMaxIterations,
+            statistics.pcgMaxResidual,
+            statistics.pcgFailures);
+
+        totals.substepCount += statistics.substepCount;
+        totals.removedParticles += statistics.removedParticles;
+        totals.pcgIterations += statistics.pcgIterations;
+        totals.pcgMaxIterations = Math::max(totals.pcgMaxIterations, statistics.pcgMaxIterations);
+        totals.pcgMaxResidual = Math::max(totals.pcgMaxResidual, statistics.pcgMaxResidual);
+        totals.pcgFailures += statistics.pcgFailures;
+    }
+
+    std::fclose(csv);
+
+    /* Summary */
+    const Double total = totals.totalDuration();
+    Utility::print("Simulated {} frames with {} substeps, {} particles at the end, {} removed\n",
+        frameCount, totals.substepCount, solver.numParticles(), totals.removedParticles);
+    for(UnsignedInt stage = 0; stage != SolverStatistics::StageCount; ++stage) {
+        Utility::print("  {}: {:.2f} ms, {:.1f}%\n",
+            SolverStatistics::stageName(SolverStatistics::Stage(stage)),
+            totals.stageDurations[stage]*1000.0,
+            total > 0.0 ? totals.stageDurations[stage]/total*100.0 : 0.0);
+    }
+    Utility::print("  total: {:.2f} ms, {:.3f} ms per frame\n",
+        total*1000.0, frameCount ? total*1000.0/frameCount : 0.0);
+    Utility::print("Pressure solve: {:.1f} iterations per substep on average, at most {}, max residual {}, {} failed\n",
+        totals.substepCount ? Double(totals.pcgIterations)/totals.substepCount : 0.0,
+        totals.pcgMaxIterations, totals.pcgMaxResidual, totals.pcgFailures);
+    Utility::print("Per-frame statistics written to {}\n", output.data());
+}
@@ -0,0 +1,292 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2020 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Utility/Assert.h>
+#include <Magnum/Math/Constants.h>
+#include <Magnum/Math/Functions.h>
+
+#include "BVH.h"
+#include "Ray.h"
+
+namespace Magnum { namespace Examples {
+
+struct BVH::BuildItem {
+    Range3D bounds;
+    Vector3 centroid;
+    UnsignedInt index;
+};
+
+namespace {
+
+constexpr UnsignedInt BinCount = 12;
+constexpr UnsignedInt StackSize = 64;
+
+/* Past this depth nodes are split at the median instead of by the surface
+   area heuristic. As there's less than 2^32 objects, that adds at most 32
+   more levels, so the depth never exceeds the traversal stack size. */
+constexpr UnsignedInt MedianSplitDepth = StackSize - 32;
+
+/* Relative costs of visiting a node and of intersecting an object, used by
+   the surface area heuristic */
+constexpr Float TraversalCost = 1.0f;
+constexpr Float IntersectionCost = 1.0f;
+
+inline Float halfArea(const Range3D& range) {
+    const Vector3 size = range.size();
+    return size.x()*size.y() + size.y()*size.z() + size.z()*size.x();
+}
+
+inline bool intersectBounds(const Range3D& bounds, const Vector3& origin,
+    const Vector3& invDirection, Float tMin, Float tMax)
+{
+    const Vector3 t0 = (bounds.min() - origin)*invDirection;
+    const Vector3 t1 = (bounds.max() - origin)*invDirection;
+    const Float tNear = Math::max(tMin, Math::min(t0, t1).max());
+    const Float tFar = Math::min(tMax, Math::max(t0, t1).min());
+    return tNear <= tFar;
+}
+
+}
+
+BVH::Statistics& BVH::threadStatistics() {
+    thread_local Statistics statistics;
+    return statistics;
+}
+
+BVH::BVH(ObjectList&& objects, UnsignedInt maxLeafSize): _maxLeafSize{maxLeafSize} {
+    CORRADE_INTERNAL_ASSERT(maxLeafSize >= 1 && maxLeafSize <= 0xffff);
+
+    Containers::Array<Containers::Pointer<Object>> input = objects.release();
+    if(input.isEmpty()) return;
+
+    Containers::Array<BuildItem> items{input.size()};
+    for(std::size_t i = 0; i != input.size(); ++i) {
+        const Range3D bounds = input[i]->bounds();
+        items[i] = BuildItem{bounds, bounds.center(), UnsignedInt(i)};
+    }
+
+    arrayReserve(_nodes, 2*input.size() - 1);
+    build(items, 0, UnsignedInt(items.size()), 1);
+    CORRADE_INTERNAL_ASSERT(_depth <= StackSize);
+
+    /* Put the objects in the order the leaves reference them */
+    _objects = Containers::Array<Containers::Pointer<Object>>{input.size()};
+    for(std::size_t i = 0; i != items.size(); ++i)
+        _objects[i] = Utility::move(input[items[i].index]);
+}
+
+UnsignedInt BVH::build(Containers::ArrayView<BuildItem> items,
+    UnsignedInt begin, UnsignedInt end, UnsignedInt depth)
+{
+    _depth = Math::max(_depth, depth);
+
+    /* Not keeping a reference to the node as the array grows during the
+       recursion */
+    const UnsignedInt nodeIndex = UnsignedInt(_nodes.size());
+    arrayAppend(_nodes, Node{});
+
+    Range3D bounds = items[begin].bounds;
+    Range3D centroidBounds{items[begin].centroid, items[begin].centroid};
+    for(UnsignedInt i = begin + 1; i != end; ++i) {
+        bounds = Math::join(bounds, items[i].bounds);
+        centroidBounds = Math::join(centroidBounds, Range3D{items[i].centroid, items[i].centroid});
+    }
+    _nodes[nodeIndex].bounds = bounds;
+
+    const UnsignedInt count = end - begin;
+    if(count == 1) {
+        _nodes[nodeIndex].offset = begin;
+        _nodes[nodeIndex].count = 1;
+        return nodeIndex;
+    }
+
+    /* Split along the axis where the centroids are spread the most */
+    const Vector3 extent = centroidBounds.size();
+    UnsignedInt axis = 0;
+    if(extent[1] > extent[axis]) axis = 1;
+    if(extent[2] > extent[axis]) axis = 2;
+
+    UnsignedInt mid;
+    if(extent[axis] <= 0.0f || depth >= MedianSplitDepth) {
+        /* All centroids in one place, nothing to split by, or too deep to
+           risk another unbalanced split */
+        if(count <= _maxLeafSize) {
+            _nodes[nodeIndex].offset = begin;
+            _nodes[nodeIndex].count = UnsignedShort(count);
+            return nodeIndex;
+        }
+
+        mid = begin + count/2;
+        std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+            [axis](const BuildItem& a, const BuildItem& b) {
+                return a.centroid[axis] < b.centroid[axis];
+            });
+    } else {
+        const Float binScale = BinCount/extent[axis];
+        const Float binStart = centroidBounds.min()[axis];
+        const auto binIndex = [&](const BuildItem& item) {
+            return Math::min(UnsignedInt((item.centroid[axis] - binStart)*binScale), BinCount - 1);
+        };
+
+        /* Bin the centroids. Empty bins have zero count and their bounds are
+           never used. */
+        Range3D binBounds[BinCount];
+        UnsignedInt binCounts[BinCount]{};
+        for(UnsignedInt i = begin; i != end; ++i) {
+            const UnsignedInt b = binIndex(items[i]);
+            binBounds[b] = binCounts[b] ? Math::join(binBounds[b], items[i].bounds) : items[i].bounds;
+            ++binCounts[b];
+        }
+
+        /* Sweep from the right to get area and count of everything past
+           each split plane, then from the left to evaluate the cost */
+        Float rightAreas[BinCount - 1];
+        UnsignedInt rightCounts[BinCount - 1];
+        {
+            Range3D rightBounds;
+            UnsignedInt rightCount = 0;
+            for(UnsignedInt b = BinCount - 1; b != 0; --b) {
+                if(binCounts[b]) {
+                    rightBounds = rightCount ? Math::join(rightBounds, binBounds[b]) : binBounds[b];
+                    rightCount += binCounts[b];
+                }
+                rightAreas[b - 1] = halfArea(rightBounds);
+                rightCounts[b - 1] = rightCount;
+            }
+        }
+
+        Float bestCost = Constants::inf();
+        UnsignedInt bestSplit = 0;
+        {
+            Range3D leftBounds;
+            UnsignedInt leftCount = 0;
+            for(UnsignedInt b = 0; b != BinCount - 1; ++b) {
+                if(binCounts[b]) {
+                    leftBounds = leftCount ? Math::join(leftBounds, binBounds[b]) : binBounds[b];
+                    leftCount += binCounts[b];
+                }
+                if(!leftCount || !rightCounts[b]) continue;
+
+                const Float cost = leftCount*halfArea(leftBounds) + rightCounts[b]*rightAreas[b];
+                if(cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        /* Make a leaf if intersecting everything is cheaper than the split */
+        const Float area = halfArea(bounds);
+        const Float splitCost = TraversalCost + IntersectionCost*bestCost/(area > 0.0f ? area : 1.0f);
+        if(count <= _maxLeafSize && splitCost >= IntersectionCost*count) {
+            _nodes[nodeIndex].offset = begin;
+            _nodes[nodeIndex].count = UnsignedShort(count);
+            return nodeIndex;
+        }
+
+        /* The first and last bin are never empty, so neither is any side */
+        mid = UnsignedInt(std::partition(items.begin() + begin, items.begin() + end,
+            [&](const BuildItem& item) { return binIndex(item) <= bestSplit; }) - items.begin());
+        CORRADE_INTERNAL_ASSERT(mid != begin && mid != end);
+    }
+
+    /* The first child is right after the parent, the second after the whole
+       subtree of the first */
+    build(items, begin, mid, depth + 1);
+    const UnsignedInt second = build(items, mid, end, depth + 1);
+    _nodes[nodeIndex].offset = second;
+    _nodes[nodeIndex].count = 0;
+    _nodes[nodeIndex].axis = UnsignedByte(axis);
+    return nodeIndex;
+}
+
+bool BVH::intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const {
+    ++threadStatistics().rays;
+    return intersectNested(r, tMin, tMax, hitInfo);
+}
+
+bool BVH::intersectNested(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const {
+    Statistics& statistics = threadStatistics();
+    if(_nodes.isEmpty()) return false;
+
+    const Vector3 invDirection = 1.0f/r.unitDirection;
+    const bool directionIsNegative[]{
+        invDirection.x() < 0.0f,
+        invDirection.y() < 0.0f,
+        invDirection.z() < 0.0f
+    };
+
+    UnsignedInt stack[StackSize];
+    UnsignedInt stackSize = 0;
+    UnsignedInt current = 0;
+    bool hit = false;
+    for(;;) {
+        const Node& node = _nodes[current];
+        ++statistics.nodesVisited;
+
+        /* tMax shrinks with each hit, so nodes behind the closest hit so far
+           get rejected here */
+        if(intersectBounds(node.bounds, r.origin, invDirection, tMin, tMax)) {
+            if(node.count) {
+                for(UnsignedInt i = node.offset, end = node.offset + node.count; i != end; ++i) {
+                    ++statistics.primitivesTested;
+                    if(_objects[i]->intersect(r, tMin, tMax, hitInfo)) {
+                        hit = true;
+                        tMax = hitInfo.t;
+                    }
+                }
+            } else {
+                /* Visit the nearer child first */
+                if(directionIsNegative[node.axis]) {
+                    stack[stackSize++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stackSize++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if(!stackSize) break;
+        current = stack[--stackSize];
+    }
+
+    return hit;
+}
+
+Range3D BVH::bounds() const {
+    return _nodes.isEmpty() ? Range3D{} : _nodes[0].bounds;
+}
+
+}}
@@ -0,0 +1,102 @@
+#ifndef Magnum_Examples_RayTracing_BVH_h
+#define Magnum_Examples_RayTracing_BVH_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2020 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Pointer.h>
+
+#include "Objects.h"
+
+namespace Magnum { namespace Examples {
+
+/* Bounding volume hierarchy over arbitrary objects. Built top-down using a
+   binned surface area heuristic, stored as a flat array of nodes in
+   depth-first order and traversed front-to-back, skipping nodes that are
+   farther than the closest hit found so far. */
+class BVH: public Object {
+    public:
+        /* Traversal counters. These are thread-local so concurrent
+           traversals don't contend on them, whoever renders is expected to
+           collect and reset them. */
+        struct Statistics {
+            UnsignedLong rays = 0;
+            UnsignedLong nodesVisited = 0;
+            UnsignedLong primitivesTested = 0;
+
+            Statistics& operator+=(const Statistics& other) {
+                rays += other.rays;
+                nodesVisited += other.nodesVisited;
+                primitivesTested += other.primitivesTested;
+                return *this;
+            }
+        };
+
+        static Statistics& threadStatistics();
+
+        /* Takes over all objects from the list */
+        explicit BVH(ObjectList&& objects, UnsignedInt maxLeafSize = 4);
+
+        bool intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const override;
+
+        /* Same as intersect() but doesn't count the ray, for hierarchies
+           traversed from leaves of another one */
+        bool intersectNested(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const;
+        Range3D bounds() const override;
+
+        std::size_t nodeCount() const { return _nodes.size(); }
+        UnsignedInt depth() const { return _depth; }
+
+    private:
+        struct Node {
+            Range3D bounds;
+            /* First object for a leaf, second child for an inner node, the
+               first child is always right after the parent */
+            UnsignedInt offset;
+            /* Zero for inner nodes */
+            UnsignedShort count;
+            UnsignedByte axis;
+        };
+
+        struct BuildItem;
+
+        UnsignedInt build(Containers::ArrayView<BuildItem> items,
+            UnsignedInt begin, UnsignedInt end, UnsignedInt depth);
+
+        Containers::Array<Containers::Pointer<Object>> _objects;
+        Containers::Array<Node> _nodes;
+        UnsignedInt _maxLeafSize;
+        UnsignedInt _depth = 0;
+};
+
+}}
+
+#endif
@@ -57,13 +57,32 @@ class Camera {
             _verticalEdge  = 2.0f*halfHeight*focusDistance*_v;
         }
 
-        Ray ray(Float s, Float t) const {
-            const Vector2 rd = _lensRadius*Rnd::rndInDisk();
+        /* The lens sample is a point in the unit square */
+        Ray ray(Float s, Float t, const Vector2& lensSample) const {
+            const Vector2 rd = _lensRadius*Rnd::rndInDisk(lensSample);
             const Vector3 offset = _u*rd.x() + _v*rd.y();
             return Ray{_origin + offset, _lowerLeftCorner + s*_horitonalEdge +
                 t*_verticalEdge - offset - _origin};
         }
 
+        /* Inverse of ray() for a pinhole camera. Returns false if the point
+           is behind the camera or outside of the view. */
+        bool project(const Vector3& point, Vector2& st) const {
+            const Vector3 direction = point - _origin;
+            const Float depth = -Math::dot(direction, _w);
+            if(depth <= 0.0f) return false;
+
+            /* Intersect with the plane the view rays are spanned on */
+            const Float planeDepth = -Math::dot(_lowerLeftCorner - _origin, _w);
+            const Vector3 onPlane = _origin + direction*(planeDepth/depth) - _lowerLeftCorner;
+            st = {Math::dot(onPlane, _horitonalEdge)/_horitonalEdge.dot(),
+                  Math::dot(onPlane, _verticalEdge)/_verticalEdge.dot()};
+            return st.x() >= 0.0f && st.x() < 1.0f &&
+                   st.y() >= 0.0f && st.y() < 1.0f;
+        }
+
+        Float lensRadius() const { return _lensRadius; }
+
     private:
         Vector3 _origin;
         Float   _lensRadius;
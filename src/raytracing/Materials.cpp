@@ -29,6 +29,7 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <Corrade/Utility/Assert.h>
 #include <Magnum/Math/Functions.h>
 
 #include "RndGenerators.h"
@@ -47,55 +48,78 @@ inline Float schlick(Float cosine, Float refIdx) {
     return r0 + (1 - r0)*Math::pow(1.0f - cosine, 5.0f);
 }
 
-}
-
-bool Lambertian::scatter(const Ray&, const HitInfo& hitInfo,
-    Vector3& attenuation, Ray& scatteredRay) const
+inline bool scatterLambertian(const Material& material,
+    const HitInfo& hitInfo, Rnd::Sampler& sampler, Vector3& attenuation,
+    Ray& scatteredRay)
 {
-    const Vector3 target = hitInfo.p + hitInfo.unitNormal + Rnd::randomInSphere();
-    scatteredRay = Ray(hitInfo.p, target - hitInfo.p);
-    attenuation  = _albedo;
+    /* Offsetting the normal by a point on the unit sphere gives a cosine
+       distribution of the scattered directions. Falling back to the normal in
+       the rare case the two cancel out. */
+    const Vector3 direction = hitInfo.unitNormal + Rnd::randomOnSphere(sampler.next2D());
+    scatteredRay = Ray(hitInfo.p, direction.dot() > 1.0e-8f ? direction : hitInfo.unitNormal);
+    attenuation = material.albedo;
     return true;
 }
 
-bool Metal::scatter(const Ray& r, const HitInfo& hitInfo,
-    Vector3& attenuation, Ray& scatteredRay) const
+inline bool scatterMetal(const Material& material, const Ray& r,
+    const HitInfo& hitInfo, Rnd::Sampler& sampler, Vector3& attenuation,
+    Ray& scatteredRay)
 {
     const Vector3 reflectedRay = Math::reflect(r.unitDirection, hitInfo.unitNormal);
-    scatteredRay = Ray(hitInfo.p, reflectedRay + _fuzziness*Rnd::randomInSphere());
-    attenuation  = _albedo;
+    const Vector2 fuzzDirection = sampler.next2D();
+    scatteredRay = Ray(hitInfo.p, reflectedRay + material.parameter*Rnd::randomInSphere(fuzzDirection, sampler.next1D()));
+    attenuation = material.albedo;
     return Math::dot(scatteredRay.unitDirection, hitInfo.unitNormal) > 0;
 }
 
-bool Dielectric::scatter(const Ray& r, const HitInfo& hitInfo,
-    Vector3& attenuation, Ray& scatteredRay) const
+inline bool scatterDielectric(const Material& material, const Ray& r,
+    const HitInfo& hitInfo, Rnd::Sampler& sampler, Vector3& attenuation,
+    Ray& scatteredRay)
 {
-    attenuation = Vector3{1.0f, 1.0f, 1.0f};
+    attenuation = material.albedo;
+    const Float refractiveIndex = material.parameter;
 
     Float niOverNt;
     Float cosine;
     Vector3 outwardNormal;
     if(Math::dot(r.unitDirection, hitInfo.unitNormal) > 0) {
         outwardNormal = -hitInfo.unitNormal;
-        niOverNt = _refractiveIndex;
+        niOverNt = refractiveIndex;
         cosine = Math::dot(r.unitDirection, hitInfo.unitNormal);
-        cosine = Math::sqrt(1 - _refractiveIndex*_refractiveIndex*(1 - cosine*cosine));
+        cosine = Math::sqrt(1 - refractiveIndex*refractiveIndex*(1 - cosine*cosine));
     } else {
         outwardNormal = hitInfo.unitNormal;
-        niOverNt = 1.0f/_refractiveIndex;
+        niOverNt = 1.0f/refractiveIndex;
         cosine = -Math::dot(r.unitDirection, hitInfo.unitNormal);
     }
 
     const Vector3 refractedDir = Math::refract(r.unitDirection, outwardNormal, niOverNt);
     const Float reflectionProbability =
         Math::dot(refractedDir, refractedDir) > 0 ?
-            schlick(cosine, _refractiveIndex) : 1.0f;
+            schlick(cosine, refractiveIndex) : 1.0f;
     scatteredRay.origin = hitInfo.p;
-    if(Rnd::rand01() < reflectionProbability)
+    if(sampler.next1D() < reflectionProbability)
         scatteredRay.unitDirection = Math::reflect(r.unitDirection, hitInfo.unitNormal);
     else scatteredRay.unitDirection = refractedDir.normalized();
 
     return true;
 }
 
+}
+
+bool scatter(const Material& material, const Ray& r, const HitInfo& hitInfo,
+    Rnd::Sampler& sampler, Vector3& attenuation, Ray& scatteredRay)
+{
+    switch(material.type) {
+        case MaterialType::Lambertian:
+            return scatterLambertian(material, hitInfo, sampler, attenuation, scatteredRay);
+        case MaterialType::Metal:
+            return scatterMetal(material, r, hitInfo, sampler, attenuation, scatteredRay);
+        case MaterialType::Dielectric:
+            return scatterDielectric(material, r, hitInfo, sampler, attenuation, scatteredRay);
+    }
+
+    CORRADE_INTERNAL_ASSERT_UNREACHABLE();
+}
+
 }}
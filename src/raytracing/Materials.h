@@ -39,50 +39,39 @@ namespace Magnum { namespace Examples {
 
 struct Ray;
 struct HitInfo;
+namespace Rnd { class Sampler; }
 
-class Material {
-    public:
-        virtual ~Material() = default;
-
-        virtual bool scatter(const Ray& r, const HitInfo& hitInfo,
-            Vector3& attenuation, Ray& scatteredRay) const = 0;
-};
-
-class Lambertian: public Material {
-    public:
-        explicit Lambertian(const Vector3& albedo): _albedo{albedo} {}
-
-        bool scatter(const Ray& r, const HitInfo& hitInfo,
-            Vector3& attenuation, Ray& scatteredRay) const override;
-
-    private:
-        Vector3 _albedo;
+enum class MaterialType: UnsignedByte {
+    Lambertian,
+    Metal,
+    Dielectric
 };
 
-class Metal: public Material {
-    public:
-        explicit Metal(const Vector3& albedo, Float f): _albedo{albedo},
-            _fuzziness{Math::min(f, 1.0f)} {}
-
-        bool scatter(const Ray& r, const HitInfo& hitInfo,
-            Vector3& attenuation, Ray& scatteredRay) const override;
-
-    private:
-        Vector3 _albedo;
-        Float _fuzziness;
+/* All material types share one plain struct, dispatched by a switch on the
+   type. The scene keeps them in a single array and objects refer to them by
+   index. */
+struct Material {
+    static Material lambertian(const Vector3& albedo) {
+        return {MaterialType::Lambertian, albedo, 0.0f};
+    }
+
+    static Material metal(const Vector3& albedo, Float fuzziness) {
+        return {MaterialType::Metal, albedo, Math::min(fuzziness, 1.0f)};
+    }
+
+    static Material dielectric(Float refractiveIndex) {
+        return {MaterialType::Dielectric, Vector3{1.0f}, refractiveIndex};
+    }
+
+    MaterialType type;
+    Vector3 albedo;
+    /* Fuzziness for metals, refractive index for dielectrics */
+    Float parameter;
 };
 
-class Dielectric: public Material {
-    public:
-        explicit Dielectric(Float refractiveIndex):
-            _refractiveIndex{refractiveIndex} {}
-
-        bool scatter(const Ray& r, const HitInfo& hitInfo,
-            Vector3& attenuation, Ray& scatteredRay) const override;
-
-    private:
-        Float _refractiveIndex;
-};
+/* Returns false if the ray got absorbed */
+bool scatter(const Material& material, const Ray& r, const HitInfo& hitInfo,
+    Rnd::Sampler& sampler, Vector3& attenuation, Ray& scatteredRay);
 
 }}
 
@@ -32,42 +32,10 @@
 #include <Corrade/Containers/GrowableArray.h>
 
 #include "Objects.h"
-#include "Materials.h"
 #include "Ray.h"
 
 namespace Magnum { namespace Examples {
 
-bool Sphere::intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const {
-    const Vector3 dir = r.unitDirection;
-    const Vector3 oc = r.origin - _center;
-    const Float a = 1.0f; /* a  = || r ||, and ray diriection r is normalized */
-    const Float b = Math::dot(dir, oc);
-    const Float c = Math::dot(oc, oc) - _radiusSqr;
-    const Float delta = b*b - a*c;
-
-    if(delta > 0.0f) {
-        const Float t1 = (-b - Math::sqrt(delta))/a;
-        if(t1 < tMax && t1 > tMin) {
-            computeHitInfo(r, t1, hitInfo);
-            return true;
-        }
-
-        const Float t2 = (-b + Math::sqrt(delta))/a;
-        if(t2 < tMax && t2 > tMin) {
-            computeHitInfo(r, t2, hitInfo);
-            return true;
-        }
-    }
-    return false;
-}
-
-void Sphere::computeHitInfo(const Ray& r, Float t, HitInfo& hitInfo) const {
-    hitInfo.t = t;
-    hitInfo.p = r.point(t);
-    hitInfo.unitNormal = (hitInfo.p - _center).normalized();
-    hitInfo.material = _material.get();
-}
-
 bool ObjectList::intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const {
     bool hit = false;
     Float minHitTime = tMax;
@@ -80,6 +48,15 @@ bool ObjectList::intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInf
     return hit;
 }
 
+Range3D ObjectList::bounds() const {
+    if(_objects.isEmpty()) return {};
+
+    Range3D bounds = _objects[0]->bounds();
+    for(std::size_t i = 1; i != _objects.size(); ++i)
+        bounds = Math::join(bounds, _objects[i]->bounds());
+    return bounds;
+}
+
 void ObjectList::addObject(Containers::Pointer<Object>&& object) {
     arrayAppend(_objects, Utility::move(object));
 }
@@ -34,42 +34,37 @@
 #include <Corrade/Containers/Array.h>
 #include <Corrade/Containers/Pointer.h>
 #include <Magnum/Magnum.h>
-#include <Magnum/Math/Vector3.h>
+#include <Magnum/Math/Range.h>
 
 namespace Magnum { namespace Examples {
 
 struct Ray;
 struct HitInfo;
-class Material;
 
 class Object {
     public:
         virtual ~Object() = default;
 
         virtual bool intersect(const Ray& r, Float t_min, Float t_max, HitInfo& hitInfo) const = 0;
-};
-
-class Sphere: public Object {
-    public:
-        explicit Sphere(const Vector3& center, Float radius,
-            Containers::Pointer<Material>&& material): _center{center},
-            _radiusSqr{radius*radius}, _material{Utility::move(material)} {}
-
-        bool intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const override;
 
-    private:
-        void computeHitInfo(const Ray& r, Float t, HitInfo& hitInfo) const;
-
-        Vector3 _center;
-        Float _radiusSqr;
-        Containers::Pointer<Material> _material;
+        /* Axis-aligned bounding box, used for building the BVH */
+        virtual Range3D bounds() const = 0;
 };
 
 class ObjectList: public Object {
     public:
         bool intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const override;
+        Range3D bounds() const override;
         void addObject(Containers::Pointer<Object>&& object);
 
+        std::size_t size() const { return _objects.size(); }
+
+        /* Move the objects out, leaving the list empty. Used for building
+           a BVH over them. */
+        Containers::Array<Containers::Pointer<Object>> release() {
+            return Utility::move(_objects);
+        }
+
     private:
         Containers::Array<Containers::Pointer<Object>> _objects;
 };
@@ -46,13 +46,12 @@ struct Ray {
     Vector3 unitDirection;
 };
 
-class Material;
-
 struct HitInfo {
     Float t;
     Vector3 p;
     Vector3 unitNormal;
-    const Material* material = nullptr;
+    /* Index into the scene material array */
+    UnsignedInt materialId = 0;
 };
 
 }}
@@ -29,14 +29,31 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include <ctime>
+#include <cstring>
+#include <utility>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/Pair.h>
+#include <Corrade/Utility/Debug.h>
+#include <Magnum/Mesh.h>
+#include <Magnum/Math/Constants.h>
 #include <Magnum/Math/Packing.h>
 #include <Magnum/Math/Vector4.h>
+#include <Magnum/Trade/AbstractImporter.h>
+#include <Magnum/Trade/MeshData.h>
+#include <Magnum/Trade/PhongMaterialData.h>
+#include <Magnum/Trade/SceneData.h>
+
+#ifdef CORRADE_TARGET_SSE2
+#include <emmintrin.h>
+#endif
 
 #include "RayTracer.h"
+#include "BVH.h"
 #include "Camera.h"
 #include "Objects.h"
 #include "Materials.h"
+#include "SphereSet.h"
+#include "TriangleMesh.h"
 
 namespace Magnum { namespace Examples {
 
@@ -45,39 +62,103 @@ namespace  {
 constexpr Vector3 BackgroundColor1{1.0f, 1.0f, 1.0f};
 constexpr Vector3 BackgroundColor2{0.5f, 0.7f, 1.0f};
 
-constexpr bool ConsistentScene = false;
+/* Russian roulette starts after this many bounces */
+constexpr UnsignedInt RussianRouletteDepth = 3;
 
-/* Perform operation on the entire block of pixels */
-template<class Function> void loopBlock(UnsignedInt blockSize,
-    const Vector2i& blockStart, const Vector2i& imageSize, Function&& func)
-{
-    for(Int y = blockStart.y(), yend = blockStart.y() + blockSize; y < yend; ++y) {
-        for(Int x = blockStart.x(), xend = blockStart.x() + blockSize; x < xend; ++x) {
-            if(x < 0 || y < 0 || x >= imageSize.x() || y >= imageSize.y())
-                continue;
+/* Rec. 709 luminance weights, the variance is estimated on luminance only */
+constexpr Vector3 LuminanceWeights{0.2126f, 0.7152f, 0.0722f};
+
+/* Relative error is taken against at least this luminance, otherwise almost
+   black pixels would never converge */
+constexpr Float MinConvergenceLuminance = 0.05f;
 
-            func(x, y);
+/* Max distance between first hits in the current and the previous view,
+   relative to the distance from the camera, for a sample to be reused */
+constexpr Float ReprojectionTolerance = 0.02f;
+
+/* Follow a path through the scene, accumulating attenuation of all bounces
+   into a single throughput instead of recursing. The first hit distance is
+   zero if the camera ray hit nothing, otherwise the material of the first hit
+   is filled as well. */
+inline Vector3 trace(UnsignedInt maxRayDepth, Ray r, const Object& objects,
+    Containers::ArrayView<const Material> materials, Rnd::Sampler& sampler,
+    Float& firstHitDistance, UnsignedInt& firstHitMaterial)
+{
+    firstHitDistance = 0.0f;
+    Vector3 throughput{1.0f};
+    for(UnsignedInt depth = 0; ; ++depth) {
+        HitInfo hitInfo;
+        if(!objects.intersect(r, 0.001f, 1e10f, hitInfo)) {
+            const Float t = 0.5f*(r.unitDirection.y() + 1.0f);
+            return throughput*((1.0f - t)*BackgroundColor1 + t*BackgroundColor2);
+        }
+        if(!depth) {
+            firstHitDistance = hitInfo.t;
+            firstHitMaterial = hitInfo.materialId;
         }
-    }
-}
 
-/* Shade the objects */
-inline Vector3 shade(UnsignedInt maxRayDepth, const Ray& r, ObjectList& objects, UnsignedInt depth) {
-    HitInfo hitInfo;
-    if(objects.intersect(r, 0.001f, 1e10f, hitInfo)) {
+        /* Nothing is emitted by the objects, so a path that ends on a
+           surface contributes nothing */
         Ray scatteredRay;
-        Vector3 attenuation{0.0f, 0.0f, 0.0f};
-        if(depth < maxRayDepth &&
-            hitInfo.material->scatter(r, hitInfo, attenuation, scatteredRay))
-        {
-            attenuation *= shade(maxRayDepth, scatteredRay, objects, depth + 1);
+        Vector3 attenuation;
+        if(depth == maxRayDepth ||
+           !scatter(materials[hitInfo.materialId], r, hitInfo, sampler, attenuation, scatteredRay))
+            return {};
+
+        throughput *= attenuation;
+
+        /* Terminate paths that would contribute little with a probability
+           given by their throughput, scaling the survivors to compensate */
+        if(depth >= RussianRouletteDepth) {
+            const Float survival = Math::min(throughput.max(), 0.95f);
+            if(sampler.next1D() >= survival) return {};
+            throughput /= survival;
         }
 
-        return attenuation;
+        r = scatteredRay;
     }
+}
 
-    const Float t = 0.5f*(r.unitDirection.y() + 1.0f);
-    return (1.0f - t)*BackgroundColor1 + t*BackgroundColor2;
+/* Absolute transformation of an object in a scene hierarchy. Transformations
+   of the object and all its parents are made absolute in place, which is
+   remembered so shared parents are calculated just once. */
+Matrix4 absoluteTransformation(UnsignedInt object,
+    Containers::ArrayView<const Int> parents,
+    Containers::ArrayView<Matrix4> transformations,
+    Containers::ArrayView<bool> absolute)
+{
+    Containers::Array<UnsignedInt> chain;
+    for(Int i = Int(object); i >= 0 && !absolute[i]; i = parents[i])
+        arrayAppend(chain, UnsignedInt(i));
+    for(std::size_t i = chain.size(); i != 0; --i) {
+        const UnsignedInt current = chain[i - 1];
+        if(parents[current] >= 0)
+            transformations[current] = transformations[parents[current]]*transformations[current];
+        absolute[current] = true;
+    }
+    return transformations[object];
+}
+
+/* Gamma-correct and quantize a row of accumulated pixels for display */
+void resolve(const Color4* in, Color4ub* out, std::size_t count) {
+    #ifdef CORRADE_TARGET_SSE2
+    /* All four channels at once, dividing alpha by itself gives 1 and the
+       integer packing saturates values above 1 */
+    const __m128 max = _mm_set1_ps(255.0f);
+    for(std::size_t i = 0; i != count; ++i) {
+        const __m128 sum = _mm_loadu_ps(in[i].data());
+        const __m128 average = _mm_div_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3)));
+        const __m128i packed = _mm_cvtps_epi32(_mm_mul_ps(_mm_sqrt_ps(average), max));
+        const __m128i words = _mm_packs_epi32(packed, packed);
+        const __m128i bytes = _mm_packus_epi16(words, words);
+        const Int value = _mm_cvtsi128_si32(bytes);
+        std::memcpy(out[i].data(), &value, 4);
+    }
+    #else
+    for(std::size_t i = 0; i != count; ++i)
+        out[i] = {Math::pack<Color3ub>(Math::sqrt(in[i].rgb()/in[i].a())),
+                  UnsignedByte(255)};
+    #endif
 }
 
 }
@@ -85,122 +166,422 @@ inline Vector3 shade(UnsignedInt maxRayDepth, const Ray& r, ObjectList& objects,
 RayTracer::RayTracer(const Vector3& eye, const Vector3& viewCenter,
     const Vector3& upDir, Deg fov, Float aspectRatio,  Float lensRadius,
     const Vector2i& imageSize, UnsignedInt blockSize,
-    UnsignedInt maxSamplesPerPixel, UnsignedInt maxRayDepth):
+    UnsignedInt maxSamplesPerPixel, UnsignedInt maxRayDepth, UnsignedInt seed,
+    UnsignedInt threadCount):
     _blockSize{blockSize}, _maxSamplesPerPixel{maxSamplesPerPixel},
     _maxRayDepth{maxRayDepth}
 {
-    /* If ConsistentScene == true, then set a fixed seed number for random
-       generator, so the render image will look the same each time running the
-       program */
-    std::srand(ConsistentScene ? 0 : std::time(nullptr));
+    /* Pixels of a tile are traversed in Morton order so consecutive rays
+       are close to each other both in a row and a column */
+    UnsignedInt mortonSize = 1;
+    while(mortonSize < blockSize) mortonSize *= 2;
+    for(UnsignedInt i = 0; i != mortonSize*mortonSize; ++i) {
+        Vector2i position;
+        for(UnsignedInt bit = 0; (1u << bit) < mortonSize; ++bit) {
+            position.x() |= Int(((i >> (2*bit)) & 1) << bit);
+            position.y() |= Int(((i >> (2*bit + 1)) & 1) << bit);
+        }
+        if(position.x() < Int(blockSize) && position.y() < Int(blockSize))
+            arrayAppend(_mortonOrder, position);
+    }
+
+    /* The seed determines the generated scene. Rendering itself uses only
+       the deterministic low-discrepancy samples, so with the same seed the
+       image is the same each time running the program. */
+    Rnd::seed(seed);
 
     setViewParameters(eye, viewCenter, upDir, fov, aspectRatio, lensRadius);
     resizeBuffers(imageSize);
     generateSceneObjects();
+
+    if(!threadCount)
+        threadCount = Math::max(std::thread::hardware_concurrency(), 1u);
+    for(UnsignedInt i = 0; i != threadCount; ++i)
+        _workers.emplace_back(&RayTracer::workerLoop, this);
 }
 
-RayTracer::~RayTracer() = default;
+RayTracer::~RayTracer() {
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _quit = true;
+        _cancel.store(true);
+    }
+    _workAvailable.notify_all();
+    for(std::thread& worker: _workers) worker.join();
+
+    /* Mesh instances reference the meshes, destroy them first */
+    _sceneObjects = nullptr;
+}
 
 void RayTracer::setViewParameters(const Vector3& eye,
     const Vector3& viewCenter, const Vector3& upDir, Deg fov,
     Float aspectRatio, Float lensRadius)
 {
-    while(_busy.load()) {}
+    cancel();
+
+    /* Keep samples of the current view for reprojection if it finished at
+       least one pass, otherwise the previous view still has more to offer */
+    if(_reprojection && _camera && _pass) {
+        std::swap(_buffer, _previousBuffer);
+        std::swap(_bufferSquared, _previousBufferSquared);
+        std::swap(_firstHits, _previousFirstHits);
+        _previousCamera = std::move(_camera);
+    }
 
-    _busy.store(true);
     _camera.emplace(eye, viewCenter, upDir, fov, aspectRatio, lensRadius);
-    clearBuffers(); /* clear buffer as camera has changed */
-    _busy.store(false);
+
+    /* Depth of field blurs differently in each view, so such samples can't
+       be reused */
+    if(!_reprojection || _camera->lensRadius() != 0.0f ||
+       (_previousCamera && _previousCamera->lensRadius() != 0.0f))
+        _previousCamera = nullptr;
+
+    restart(); /* clear buffer as camera has changed */
 }
 
 void RayTracer::resizeBuffers(const Vector2i& imageSize) {
     /* Should not touch the buffers while rendering */
-    while(_busy.load()) {}
-
-    _busy.store(true);
+    cancel();
     _imageSize = imageSize;
     arrayResize(_pixels, imageSize.product());
     arrayResize(_buffer, imageSize.product());
+    arrayResize(_bufferSquared, imageSize.product());
+    arrayResize(_firstHits, imageSize.product());
+    arrayResize(_previousBuffer, imageSize.product());
+    arrayResize(_previousBufferSquared, imageSize.product());
+    arrayResize(_previousFirstHits, imageSize.product());
     _numBlocks = (imageSize + Vector2i{Int(_blockSize - 1)})/_blockSize;
     clearBuffers();
-    _busy.store(false);
 }
 
 void RayTracer::clearBuffers() {
-    _currentBlock = Vector2i(0, _numBlocks.y() - 1);
-    _blockMovingDir = 1;
-    for(std::size_t i = 0; i != _buffer.size(); ++i)
+    cancel();
+    _previousCamera = nullptr;
+    restart();
+}
+
+void RayTracer::restart() {
+    for(std::size_t i = 0; i != _buffer.size(); ++i) {
         _buffer[i] = Vector4{0.0f};
+        _bufferSquared[i] = 0.0f;
+        _firstHits[i] = Vector4{0.0f};
+    }
+    _samplesTraced.store(0);
+    _raysTraced.store(0);
+    _nodesVisited.store(0);
+
+    const UnsignedInt tileCount = UnsignedInt(_numBlocks.product());
+    {
+        std::lock_guard<std::mutex> lock{_tileUpdatesMutex};
+        _pendingTileUpdates.assign(tileCount, -1);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _passTiles.resize(tileCount);
+        for(UnsignedInt i = 0; i != tileCount; ++i) _passTiles[i] = i;
+        _tileConverged.assign(tileCount, 0);
+        _pass = 0;
+        _nextTile = 0;
+        _finishedTiles = 0;
+        _completedPasses.store(0);
+        _convergedTiles.store(0);
+        _done.store(false);
+        _running = _camera && _sceneObjects && tileCount;
+    }
+    _workAvailable.notify_all();
+}
 
-    _numRenderPass = 0;
-}
-
-void RayTracer::renderBlock() {
-    if(_numRenderPass >= _maxSamplesPerPixel) return;
-
-    /* Wait if there's any buffer is currently resized */
-    while(_busy.load()) {}
-    _busy.store(true);
-
-    /* Render the current block */
-    Vector2i blockStart = _currentBlock*_blockSize;
-    loopBlock(_blockSize, blockStart, _imageSize, [&](Int x, Int y) {
-        const Float u = (x + Rnd::rand01())/Float(_imageSize.x());
-        const Float v = (y + Rnd::rand01())/Float(_imageSize.y());
-        const Ray r = _camera->ray(u, v);
-        const Vector3 color = shade(_maxRayDepth, r, *_sceneObjects, 0);
-        const Int pixelIdx  = y*_imageSize.x() + x;
-        Color4& pixelColor = _buffer[pixelIdx];
-
-        /* Accumulate into the render buffer */
-        pixelColor += Color4{color, 1.0f};
-        /* Update the pixel buffer */
-        _pixels[pixelIdx] = {
-            Math::pack<Color3ub>(Math::sqrt(pixelColor.rgb()/pixelColor.a())),
-            UnsignedByte(255)
-        };
+void RayTracer::setAdaptiveSampling(Float threshold, UnsignedInt minSamples) {
+    cancel();
+    _adaptiveThreshold = threshold;
+    /* The variance estimate needs at least two samples */
+    _adaptiveMinSamples = Math::max(minSamples, 2u);
+    clearBuffers();
+}
+
+void RayTracer::wait() {
+    std::unique_lock<std::mutex> lock{_mutex};
+    _workAvailable.wait(lock, [&]{
+        return !_running || _done.load();
     });
+}
 
-    /* Mark out the next block to display */
-    _currentBlock = nextBlock(_currentBlock);
-    if(_markNextBlock && _numRenderPass < _maxSamplesPerPixel) {
-        blockStart = _currentBlock*_blockSize;
-        loopBlock(_blockSize, blockStart, _imageSize, [&](Int x, Int y) {
-            const Int pixelIdx = y*_imageSize.x() + x;
-            _pixels[pixelIdx] = {100u, 100u, 255u, 255u};
+void RayTracer::setPaused(bool paused) {
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _paused = paused;
+    }
+    _workAvailable.notify_all();
+}
+
+void RayTracer::cancel() {
+    {
+        std::unique_lock<std::mutex> lock{_mutex};
+        /* Stop workers from picking up new tiles while the lock is released
+           in the wait below, and make the running ones return early */
+        _running = false;
+        _cancel.store(true);
+        _workersIdle.wait(lock, [&]{ return _activeTiles == 0; });
+        _cancel.store(false);
+    }
+    /* Wake up wait() */
+    _workAvailable.notify_all();
+
+    /* Tiles handed over but not displayed yet are for a different camera or
+       image size */
+    std::lock_guard<std::mutex> lock{_tileUpdatesMutex};
+    for(TileUpdate& update: _tileUpdates) {
+        _pendingTileUpdates[update.tile] = -1;
+        if(!update.pixels.isEmpty()) _freeTileUpdates.push_back(std::move(update));
+    }
+    _tileUpdates.clear();
+}
+
+void RayTracer::workerLoop() {
+    std::unique_lock<std::mutex> lock{_mutex};
+    for(;;) {
+        _workAvailable.wait(lock, [&]{
+            return _quit || (_running && !_paused && !_done.load() &&
+                _nextTile < _passTiles.size());
         });
+        if(_quit) return;
+
+        /* The next pass is started only once all tiles of this one are
+           finished, so no two workers ever accumulate into the same pixels */
+        const UnsignedInt tile = _passTiles[_nextTile++];
+        const UnsignedInt pass = _pass;
+        ++_activeTiles;
+        lock.unlock();
+        const bool finished = renderTile(tile, pass);
+        lock.lock();
+        --_activeTiles;
+
+        if(finished && ++_finishedTiles == _passTiles.size()) {
+            _finishedTiles = 0;
+            _nextTile = 0;
+            _completedPasses.store(++_pass);
+
+            /* Converged tiles are not rendered in the next passes anymore,
+               so the remaining samples go only to the noisy regions */
+            if(_pass >= _maxSamplesPerPixel) _done.store(true);
+            else {
+                std::size_t out = 0;
+                for(const UnsignedInt passTile: _passTiles)
+                    if(!_tileConverged[passTile]) _passTiles[out++] = passTile;
+                _convergedTiles += UnsignedInt(_passTiles.size() - out);
+                _passTiles.resize(out);
+                if(_passTiles.empty()) _done.store(true);
+            }
+            _workAvailable.notify_all();
+        }
+        if(!_activeTiles) _workersIdle.notify_all();
     }
+}
 
-    _busy.store(false);
+bool RayTracer::renderTile(UnsignedInt tile, UnsignedInt pass) {
+    /* Going from the top row of tiles down */
+    const Vector2i block{Int(tile%_numBlocks.x()),
+        _numBlocks.y() - 1 - Int(tile/_numBlocks.x())};
+    const Range2Di range{block*Int(_blockSize),
+        Math::min((block + Vector2i{1})*Int(_blockSize), _imageSize)};
+
+    if(_markTiles.load() && _handOverTiles.load())
+        pushTileUpdate(TileUpdate{tile, range, {}});
+
+    /* Accumulate into the render buffer, checking for cancellation after
+       every block size worth of pixels. Tiles on the image edge skip
+       positions outside of the image. */
+    BVH::Statistics& statistics = BVH::threadStatistics();
+    statistics = {};
+    const bool edgeTile = range.size() != Vector2i{Int(_blockSize)};
+    Float minSampleCount = Constants::inf();
+    for(std::size_t i = 0; i != _mortonOrder.size(); ++i) {
+        if(i % _blockSize == 0 && _cancel.load(std::memory_order_relaxed))
+            return false;
+
+        const Vector2i position = range.min() + _mortonOrder[i];
+        if(edgeTile && (position >= range.max()).any()) continue;
+
+        /* Pixel jitter, lens position and scatter directions all come from
+           the low-discrepancy sequence, with the pass being the sample
+           index, so the traversal order doesn't affect the image */
+        const Int x = position.x();
+        const Int y = position.y();
+        const Int pixelIdx = y*_imageSize.x() + x;
+        Rnd::Sampler sampler{UnsignedInt(pixelIdx), pass};
+        const Vector2 jitter = sampler.next2D();
+        const Float u = (x + jitter.x())/Float(_imageSize.x());
+        const Float v = (y + jitter.y())/Float(_imageSize.y());
+        const Ray r = _camera->ray(u, v, sampler.next2D());
+        Float firstHitDistance;
+        UnsignedInt firstHitMaterial;
+        const Vector3 color = trace(_maxRayDepth, r, *_sceneObjects, _materials, sampler, firstHitDistance, firstHitMaterial);
+        _buffer[pixelIdx] += Color4{color, 1.0f};
+        const Float luminance = Math::dot(color, LuminanceWeights);
+        _bufferSquared[pixelIdx] += luminance*luminance;
+
+        /* Radiance of reflections and refractions depends on the view
+           direction, so only samples of diffuse surfaces are reused. Others
+           are recorded as a miss so they're not reprojected later either. */
+        if(pass == 0 && firstHitDistance > 0.0f &&
+           _materials[firstHitMaterial].type == MaterialType::Lambertian)
+        {
+            const Vector3 firstHit = r.point(firstHitDistance);
+            _firstHits[pixelIdx] = Vector4{firstHit, 1.0f};
+            if(_previousCamera)
+                reprojectPixel(pixelIdx, firstHit, firstHitDistance);
+        }
+        minSampleCount = Math::min(minSampleCount, _buffer[pixelIdx].a());
+    }
+    _samplesTraced += UnsignedLong(range.size().product());
+    _raysTraced += statistics.rays;
+    _nodesVisited += statistics.nodesVisited;
+
+    /* Only this worker touches the flag until the pass ends. If all pixels
+       got enough history reprojected, the tile is done already after the
+       first pass, even without adaptive sampling. The scaled history
+       sample count isn't exactly integral, allow for rounding errors. */
+    _tileConverged[tile] =
+        minSampleCount + 0.5f >= Float(_maxSamplesPerPixel) ||
+        (_adaptiveThreshold > 0.0f && tileConverged(range));
+
+    /* Nobody calls update() to take the tiles */
+    if(!_handOverTiles.load()) return true;
+
+    /* Resolve the tile for display into a recycled array, once per pass
+       instead of after every sample */
+    TileUpdate update;
+    {
+        std::lock_guard<std::mutex> lock{_tileUpdatesMutex};
+        if(!_freeTileUpdates.empty()) {
+            update = std::move(_freeTileUpdates.back());
+            _freeTileUpdates.pop_back();
+        }
+    }
+    const std::size_t pixelCount = range.size().product();
+    if(update.pixels.size() != pixelCount)
+        update.pixels = Containers::Array<Color4ub>{NoInit, pixelCount};
+    update.tile = tile;
+    update.range = range;
+    for(Int y = range.min().y(); y != range.max().y(); ++y)
+        resolve(_buffer.data() + y*_imageSize.x() + range.min().x(),
+            update.pixels.data() + (y - range.min().y())*range.sizeX(),
+            range.sizeX());
+
+    pushTileUpdate(std::move(update));
+    return true;
 }
 
-Vector2i RayTracer::nextBlock(const Vector2i& currentBlock) {
-    Vector2i nextBlock = currentBlock;
-    nextBlock.x() += _blockMovingDir;
+void RayTracer::pushTileUpdate(TileUpdate&& update) {
+    std::lock_guard<std::mutex> lock{_tileUpdatesMutex};
+
+    /* If the display didn't pick up the previous update of this tile yet,
+       replace it so each dirty tile gets copied just once */
+    Int& pending = _pendingTileUpdates[update.tile];
+    if(pending != -1) {
+        TileUpdate& previous = _tileUpdates[pending];
+        if(!previous.pixels.isEmpty())
+            _freeTileUpdates.push_back(std::move(previous));
+        previous = std::move(update);
+        return;
+    }
+
+    pending = Int(_tileUpdates.size());
+    _tileUpdates.push_back(std::move(update));
+}
 
-    if(nextBlock.x() == _numBlocks.x() || nextBlock.x() == -1) {
-        nextBlock.x() = Math::clamp(nextBlock.x(), 0, _numBlocks.x() - 1);
-        nextBlock.y() = currentBlock.y() - 1;
-        _blockMovingDir = -_blockMovingDir;
+bool RayTracer::tileConverged(const Range2Di& range) const {
+    for(Int y = range.min().y(); y != range.max().y(); ++y) {
+        for(Int x = range.min().x(); x != range.max().x(); ++x) {
+            const Int pixelIdx = y*_imageSize.x() + x;
+            const Float n = _buffer[pixelIdx].a();
+            if(n < _adaptiveMinSamples) return false;
+            const Float mean = Math::dot(_buffer[pixelIdx].rgb(), LuminanceWeights)/n;
+
+            /* Unbiased sample variance, the standard error of the mean is
+               then the variance divided by the sample count */
+            const Float variance = Math::max(_bufferSquared[pixelIdx]/n - mean*mean, 0.0f)*n/(n - 1.0f);
+            const Float error = Math::sqrt(variance/n)/Math::max(mean, MinConvergenceLuminance);
+            if(error > _adaptiveThreshold) return false;
+        }
     }
 
-    if(nextBlock.y() == -1) {
-        nextBlock.x() = 0;
-        nextBlock.y() = _numBlocks.y() - 1;
-        _blockMovingDir = 1;
-        ++_numRenderPass;
+    return true;
+}
+
+void RayTracer::reprojectPixel(const Int pixelIdx, const Vector3& firstHit, const Float distance) {
+    Vector2 st;
+    if(!_previousCamera->project(firstHit, st)) return;
+
+    /* Reject samples of surfaces that were occluded or not there at all in
+       the previous view */
+    const Vector2i previousPixel{st*Vector2{_imageSize}};
+    const Int previousPixelIdx = previousPixel.y()*_imageSize.x() + previousPixel.x();
+    const Vector4& previousHit = _previousFirstHits[previousPixelIdx];
+    const Float tolerance = ReprojectionTolerance*distance;
+    if(previousHit.w() == 0.0f ||
+       (previousHit.xyz() - firstHit).dot() > tolerance*tolerance)
+        return;
+
+    /* Scale the history down so that together with the sample traced in
+       this pass the pixel has at most the max sample count. Tiles in which
+       all pixels reach it are not rendered in the next passes. */
+    const Color4& previous = _previousBuffer[previousPixelIdx];
+    const Float scale = Math::min(1.0f, Float(_maxSamplesPerPixel - 1)/previous.a());
+    _buffer[pixelIdx] += previous*scale;
+    _bufferSquared[pixelIdx] += _previousBufferSquared[previousPixelIdx]*scale;
+}
+
+bool RayTracer::update() {
+    {
+        std::lock_guard<std::mutex> lock{_tileUpdatesMutex};
+        std::swap(_tileUpdates, _displayedTileUpdates);
+        for(const TileUpdate& update: _displayedTileUpdates)
+            _pendingTileUpdates[update.tile] = -1;
+    }
+    if(_displayedTileUpdates.empty()) return false;
+
+    for(const TileUpdate& update: _displayedTileUpdates) {
+        const Int width = update.range.sizeX();
+        for(Int y = update.range.min().y(); y != update.range.max().y(); ++y) {
+            Color4ub* const row = _pixels.data() + y*_imageSize.x() + update.range.min().x();
+            if(update.pixels.isEmpty()) {
+                for(Int x = 0; x != width; ++x)
+                    row[x] = Color4ub{100u, 100u, 255u, 255u};
+            } else std::memcpy(row,
+                update.pixels.data() + (y - update.range.min().y())*width,
+                width*sizeof(Color4ub));
+        }
     }
 
-    return nextBlock;
+    {
+        std::lock_guard<std::mutex> lock{_tileUpdatesMutex};
+        for(TileUpdate& update: _displayedTileUpdates)
+            if(!update.pixels.isEmpty()) _freeTileUpdates.push_back(std::move(update));
+    }
+    _displayedTileUpdates.clear();
+    return true;
+}
+
+void RayTracer::resolveBuffer() {
+    resolve(_buffer.data(), _pixels.data(), _pixels.size());
 }
 
 void RayTracer::generateSceneObjects() {
-    _sceneObjects.emplace();
+    cancel();
+
+    /* The spheres refer to materials by ID */
+    arrayResize(_materials, 0);
+    Containers::Array<SphereSet::Item> spheres;
+    const auto addSphere = [&](const Vector3& center, Float radius, const Material& material) {
+        arrayAppend(spheres, SphereSet::Item{center, radius, UnsignedInt(_materials.size())});
+        arrayAppend(_materials, material);
+    };
 
     /* Big sphere as floor */
-    _sceneObjects->addObject(Containers::pointer<Sphere>(
-        Vector3{0.0f, -1000.0f, 0.0f}, 1000.0f,
-        Containers::pointer<Lambertian>(Vector3{0.5f, 0.5f, 0.5f})));
+    addSphere(Vector3{0.0f, -1000.0f, 0.0f}, 1000.0f,
+        Material::lambertian(Vector3{0.5f, 0.5f, 0.5f}));
 
     const Vector3 centerBigSphere1{0.0f, 1.0f, 0.0f};
     const Vector3 centerBigSphere2{-4.0f, 1.0f, 0.0f};
@@ -213,43 +594,152 @@ void RayTracer::generateSceneObjects() {
                (center - centerBigSphere2).length() > 1.0f + radius &&
                (center - centerBigSphere3).length() > 1.0f + radius)
             {
-                Containers::Pointer<Material> material;
+                Material material;
                 const Float selectMat = Rnd::rand01();
 
                 /* Diffuse */
                 if(selectMat < 0.7f)
-                    material = Containers::pointer<Lambertian>(Vector3{
+                    material = Material::lambertian(Vector3{
                         Rnd::rand01()*Rnd::rand01(),
                         Rnd::rand01()*Rnd::rand01(),
                         Rnd::rand01()*Rnd::rand01()});
                 /* \m/ */
                 else if(selectMat < 0.9f)
-                    material = Containers::pointer<Metal>(Vector3{
+                    material = Material::metal(Vector3{
                         0.5f*(1.0f + Rnd::rand01()),
                         0.5f*(1.0f + Rnd::rand01()),
                         0.5f*(1.0f + Rnd::rand01())}, 0.5f*Rnd::rand01());
                 /* Dielectric */
-                else material = Containers::pointer<Dielectric>(
+                else material = Material::dielectric(
                     1.1f + 3.0f*Rnd::rand01());
 
-                _sceneObjects->addObject(Containers::pointer<Sphere>(
-                    center, radius, Utility::move(material)));
+                addSphere(center, radius, material);
             }
         }
     }
 
-    _sceneObjects->addObject(Containers::pointer<Sphere>(centerBigSphere1,
-        1.0f, Containers::pointer<Dielectric>(1.5f)));
-    _sceneObjects->addObject(Containers::pointer<Sphere>(centerBigSphere2,
-        1.0f, Containers::pointer<Lambertian>(Vector3{
-            Rnd::rand01()*Rnd::rand01(),
-            Rnd::rand01()*Rnd::rand01(),
-            Rnd::rand01()*Rnd::rand01()})));
-    _sceneObjects->addObject(Containers::pointer<Sphere>(centerBigSphere3,
-        1.0f, Containers::pointer<Metal>(Vector3{
-            0.5f*(1.0f + Rnd::rand01()),
-            0.5f*(1.0f + Rnd::rand01()),
-            0.5f*(1.0f + Rnd::rand01())}, 0.0f)));
+    addSphere(centerBigSphere1, 1.0f, Material::dielectric(1.5f));
+    addSphere(centerBigSphere2, 1.0f, Material::lambertian(Vector3{
+        Rnd::rand01()*Rnd::rand01(),
+        Rnd::rand01()*Rnd::rand01(),
+        Rnd::rand01()*Rnd::rand01()}));
+    addSphere(centerBigSphere3, 1.0f, Material::metal(Vector3{
+        0.5f*(1.0f + Rnd::rand01()),
+        0.5f*(1.0f + Rnd::rand01()),
+        0.5f*(1.0f + Rnd::rand01())}, 0.0f));
+
+    /* Nearby spheres are grouped into small sets that are tested against a
+       ray all at once, and the BVH is built over these */
+    _sceneObjects = Containers::pointer<BVH>(SphereSet::clusters(spheres));
+    _meshes = {};
+    clearBuffers();
+}
+
+bool RayTracer::importScene(Trade::AbstractImporter& importer) {
+    cancel();
+    _sceneObjects = nullptr;
+
+    /* Only the diffuse color is used. Materials that fail to load and
+       meshes without a material get a default one at the end. */
+    arrayResize(_materials, 0);
+    for(UnsignedInt i = 0; i != importer.materialCount(); ++i) {
+        Containers::Optional<Trade::MaterialData> materialData = importer.material(i);
+        if(!materialData) {
+            Warning{} << "Cannot load material" << i << importer.materialName(i);
+            arrayAppend(_materials, Material::lambertian(Vector3{0.8f}));
+            continue;
+        }
+
+        arrayAppend(_materials, Material::lambertian(
+            materialData->as<Trade::PhongMaterialData>().diffuseColor().rgb()));
+    }
+    const UnsignedInt defaultMaterial = UnsignedInt(_materials.size());
+    arrayAppend(_materials, Material::lambertian(Vector3{0.8f}));
+
+    /* Build a bottom level hierarchy for each mesh, regardless of how many
+       times it's referenced */
+    _meshes = Containers::Array<Containers::Pointer<TriangleMesh>>{importer.meshCount()};
+    for(UnsignedInt i = 0; i != importer.meshCount(); ++i) {
+        Containers::Optional<Trade::MeshData> meshData = importer.mesh(i);
+        if(!meshData || meshData->primitive() != MeshPrimitive::Triangles ||
+           !meshData->hasAttribute(Trade::MeshAttribute::Position))
+        {
+            Warning{} << "Cannot load mesh" << i << importer.meshName(i);
+            continue;
+        }
+
+        const Containers::Array<Vector3> positions = meshData->positions3DAsArray();
+        Containers::Array<UnsignedInt> indices;
+        if(meshData->isIndexed())
+            indices = meshData->indicesAsArray();
+        else {
+            indices = Containers::Array<UnsignedInt>{NoInit, positions.size()};
+            for(UnsignedInt j = 0; j != indices.size(); ++j) indices[j] = j;
+        }
+        _meshes[i] = Containers::pointer<TriangleMesh>(positions, indices);
+    }
+
+    /* The top level hierarchy is built over all mesh instances. If the file
+       has no scene, the first mesh is shown as-is. */
+    ObjectList instances;
+    std::size_t triangleCount = 0;
+    if(importer.defaultScene() == -1) {
+        if(!_meshes.isEmpty() && _meshes[0]) {
+            instances.addObject(Containers::pointer<MeshInstance>(*_meshes[0],
+                Matrix4{}, defaultMaterial));
+            triangleCount += _meshes[0]->triangleCount();
+        }
+    } else {
+        Containers::Optional<Trade::SceneData> scene;
+        if(!(scene = importer.scene(importer.defaultScene())) ||
+           !scene->is3D() ||
+           !scene->hasField(Trade::SceneField::Parent) ||
+           !scene->hasField(Trade::SceneField::Mesh))
+        {
+            Error{} << "Cannot load scene" << importer.defaultScene()
+                << importer.sceneName(importer.defaultScene());
+            _meshes = {};
+            clearBuffers();
+            return false;
+        }
+
+        /* Objects that are not part of the hierarchy stay at -2 and are
+           ignored, objects without a transformation entry have an identity
+           transformation */
+        const std::size_t objectCount = scene->mappingBound();
+        Containers::Array<Int> parents{DirectInit, objectCount, -2};
+        for(const Containers::Pair<UnsignedInt, Int>& parent: scene->parentsAsArray())
+            parents[parent.first()] = parent.second();
+        Containers::Array<Matrix4> transformations{objectCount};
+        for(const Containers::Pair<UnsignedInt, Matrix4>& transformation:
+            scene->transformations3DAsArray())
+        {
+            transformations[transformation.first()] = transformation.second();
+        }
+        Containers::Array<bool> absolute{ValueInit, objectCount};
+
+        /* There can be multiple mesh assignments for one object, add an
+           instance for each */
+        for(const Containers::Pair<UnsignedInt, Containers::Pair<UnsignedInt, Int>>&
+            meshMaterial: scene->meshesMaterialsAsArray())
+        {
+            const UnsignedInt object = meshMaterial.first();
+            const UnsignedInt mesh = meshMaterial.second().first();
+            const Int material = meshMaterial.second().second();
+            if(parents[object] == -2 || !_meshes[mesh]) continue;
+
+            instances.addObject(Containers::pointer<MeshInstance>(*_meshes[mesh],
+                absoluteTransformation(object, parents, transformations, absolute),
+                material == -1 ? defaultMaterial : UnsignedInt(material)));
+            triangleCount += _meshes[mesh]->triangleCount();
+        }
+    }
+
+    Debug{} << "Imported" << instances.size() << "mesh instances with"
+        << triangleCount << "triangles in total";
+    _sceneObjects = Containers::pointer<BVH>(std::move(instances));
+    clearBuffers();
+    return true;
 }
 
 }}
@@ -33,86 +33,236 @@
 */
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <Corrade/Containers/Array.h>
 #include <Corrade/Containers/GrowableArray.h>
 #include <Corrade/Containers/Pointer.h>
 #include <Magnum/Magnum.h>
-#include <Magnum/Math/Vector3.h>
 #include <Magnum/Math/Color.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/Math/Vector3.h>
+#include <Magnum/Trade/Trade.h>
 
 namespace Magnum { namespace Examples {
 
 struct Ray;
-class ObjectList;
+class Object;
 class Camera;
+struct Material;
+class TriangleMesh;
 
+/* Renders the image in passes, each adding one sample to every pixel of
+   tiles that didn't converge yet. Tiles of a pass are rendered in parallel by
+   a pool of worker threads, finished tiles are handed over to the display
+   thread in update(). */
 class RayTracer {
     public:
+        /* The seed is used for generating the scene. If threadCount is zero,
+           one worker per hardware thread is used. */
         explicit RayTracer(const Vector3& eye, const Vector3& viewCenter,
             const Vector3& upDir, Deg fov, Float aspectRatio, Float lensRadius,
             const Vector2i& imageSize, UnsignedInt blockSize,
-            UnsignedInt maxSamplesPerPixel, UnsignedInt maxRayDepth);
+            UnsignedInt maxSamplesPerPixel, UnsignedInt maxRayDepth,
+            UnsignedInt seed, UnsignedInt threadCount = 0);
 
         ~RayTracer();
 
-        /* Current block */
-        Vector2i currentBlock() const { return _currentBlock; }
+        /* Count of finished passes */
+        UnsignedInt iteration() const { return _completedPasses.load(); }
 
-        /* Current iteration */
-        UnsignedInt iteration() const { return _numRenderPass; }
+        /* Whether the raytracer is done processing all iterations or all
+           tiles converged */
+        bool done() const { return _done.load(); }
 
-        /* Whether the raytracer is done processing all iterations */
-        bool done() const {
-            return _numRenderPass >= _maxSamplesPerPixel;
-        }
+        /* Stop sampling a tile once the standard error of the mean luminance
+           relative to the luminance itself is below the threshold in all its
+           pixels, but not before it got minSamples. Zero threshold disables
+           adaptive sampling. Starts over. */
+        void setAdaptiveSampling(Float threshold, UnsignedInt minSamples);
+
+        /* Count of tiles that converged or got all samples from the previous
+           view and are not sampled anymore */
+        UnsignedInt convergedTiles() const { return _convergedTiles.load(); }
+
+        /* Total count of tiles */
+        UnsignedInt tileCount() const { return UnsignedInt(_numBlocks.product()); }
+
+        /* Copy tiles finished since the last call into the rendered buffer.
+           Doesn't wait for the workers, returns false if there was nothing
+           new. This should be called in every drawEvent(). */
+        bool update();
+
+        /* Block until all iterations are done. Then the accumulated buffer
+           is safe to read and the next update() hands over all remaining
+           tiles. */
+        void wait();
 
-        /* Render a block in the buffer image. This should be called in every
-           drawEvent(). */
-        void renderBlock();
+        /* Pause or resume the workers. Tiles already being rendered are
+           finished. */
+        void setPaused(bool paused);
 
-        /* Toggle marking next render block by a different color */
-        bool& markNextBlock() { return _markNextBlock; }
-        const bool& markNextBlock() const { return _markNextBlock; }
+        /* Mark tiles that are being rendered by a different color */
+        bool markTiles() const { return _markTiles.load(); }
+        void setMarkTiles(bool mark) { _markTiles.store(mark); }
 
-        /* Set the camera view parameters */
+        /* Hand finished tiles over to update(). If disabled, nothing is
+           queued for display and the image is meant to be taken with
+           resolveBuffer() after wait() instead. */
+        bool handOverTiles() const { return _handOverTiles.load(); }
+        void setHandOverTiles(bool handOver) { _handOverTiles.store(handOver); }
+
+        /* Set the camera view parameters. Cancels tiles that are being
+           rendered and starts over, keeping the samples that can be
+           reprojected into the new view if reprojection is enabled. */
         void setViewParameters(const Vector3& eye, const Vector3& viewCenter,
             const Vector3& upDir, Deg fov, Float aspectRatio, Float lensRadius);
 
+        /* Reuse samples of surfaces that stay visible when the camera moves.
+           Only for cameras without depth of field. */
+        bool reprojection() const { return _reprojection; }
+        void setReprojection(bool enabled) { _reprojection = enabled; }
+
         /* Update size of the render buffer. Should be called in the
            viewportEvent(). */
         void resizeBuffers(const Vector2i& imageSize);
 
-        /* Clear the render buffer data */
+        /* Clear the render buffer data and start over */
         void clearBuffers();
 
-        /* Generate scene. Will produce a new, different scene if
-           ConsistentScene is false. */
+        /* Generate a new, different scene and start over */
         void generateSceneObjects();
 
-        /* Get the rendered image. This should be called after renderBlock() in
+        /* Replace the scene with meshes from the default scene of an opened
+           file and start over. Diffuse colors of the materials are used as
+           albedo of Lambertian materials. Returns false if the scene can't
+           be imported. */
+        bool importScene(Trade::AbstractImporter& importer);
+
+        /* Count of camera samples since the buffers were last cleared. With
+           adaptive sampling this is less than iteration() times pixel
+           count. */
+        UnsignedLong samplesTraced() const { return _samplesTraced.load(); }
+
+        /* Count of rays traced since the buffers were last cleared, including
+           the scattered ones */
+        UnsignedLong raysTraced() const { return _raysTraced.load(); }
+
+        /* Average count of BVH nodes visited per ray since the buffers were
+           last cleared */
+        Float nodesVisitedPerRay() const {
+            const UnsignedLong rays = _raysTraced.load();
+            return rays ? Float(_nodesVisited.load())/Float(rays) : 0.0f;
+        }
+
+        /* Get the rendered image. This should be called after update() in
            every drawEvent() */
         Containers::ArrayView<const Color4ub> renderedBuffer() const {
             return _pixels;
         }
 
+        /* Resolve the whole accumulated buffer into the rendered buffer at
+           once. Safe to call only while the workers are stopped, i.e. after
+           wait(). */
+        void resolveBuffer();
+
+        /* Sum of linear radiance samples in RGB and their count in alpha.
+           Safe to read only while the workers are stopped, i.e. after wait(). */
+        Containers::ArrayView<const Color4> accumulatedBuffer() const {
+            return _buffer;
+        }
+
     private:
-        /* Identify the next pixel block to render */
-        Vector2i nextBlock(const Vector2i& currentBlock);
+        /* Tile pixels handed over from a worker, empty if the tile was just
+           started and should be marked */
+        struct TileUpdate {
+            UnsignedInt tile;
+            Range2Di range;
+            Containers::Array<Color4ub> pixels;
+        };
+
+        void workerLoop();
+
+        /* Returns false if cancelled in the middle */
+        bool renderTile(UnsignedInt tile, UnsignedInt pass);
+
+        /* Queue a tile for display, replacing its update that wasn't
+           displayed yet */
+        void pushTileUpdate(TileUpdate&& update);
+
+        /* Whether all pixels of a tile are below the adaptive threshold */
+        bool tileConverged(const Range2Di& range) const;
+
+        /* Add accumulated samples of the previous view if its first hit
+           matches the first hit in the current view */
+        void reprojectPixel(Int pixelIdx, const Vector3& firstHit, Float distance);
+
+        /* Clear the buffers and the schedule, expects that cancel() was
+           called */
+        void restart();
+
+        /* Wait until all workers finish or abandon their tiles, after that
+           the scene, camera and buffers can be modified */
+        void cancel();
 
         Containers::Pointer<Camera> _camera;
-        Containers::Pointer<ObjectList> _sceneObjects;
+        Containers::Array<Material> _materials;
+        Containers::Pointer<Object> _sceneObjects;
+        /* Bottom level hierarchies referenced by mesh instances in the scene,
+           null for meshes that failed to import */
+        Containers::Array<Containers::Pointer<TriangleMesh>> _meshes;
         Containers::Array<Color4ub> _pixels;
         Containers::Array<Color4> _buffer;
+        /* Sum of squared luminance samples for variance estimation */
+        Containers::Array<Float> _bufferSquared;
+        /* World position of the first hit of the first sample in XYZ, W is
+           zero if the sample didn't hit anything or hit a surface that isn't
+           Lambertian */
+        Containers::Array<Vector4> _firstHits;
+
+        /* Samples of the last view that finished at least one pass, merged
+           into the current view during its first pass. The camera is null if
+           there's nothing to reproject. */
+        Containers::Pointer<Camera> _previousCamera;
+        Containers::Array<Color4> _previousBuffer;
+        Containers::Array<Float> _previousBufferSquared;
+        Containers::Array<Vector4> _previousFirstHits;
+        bool _reprojection = false;
 
         Vector2i _imageSize;
         Vector2i _numBlocks;
-        Vector2i _currentBlock;
-        Int _blockMovingDir = 1;
-        UnsignedInt _numRenderPass = 0;
         UnsignedInt _blockSize, _maxSamplesPerPixel, _maxRayDepth;
+        /* Pixel offsets inside a tile in the order they're rendered */
+        Containers::Array<Vector2i> _mortonOrder;
+        Float _adaptiveThreshold = 0.0f;
+        UnsignedInt _adaptiveMinSamples = 16;
+
+        /* Workers and the schedule, guarded by _mutex */
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _workAvailable, _workersIdle;
+        bool _running = false, _paused = false, _quit = false;
+        UnsignedInt _pass = 0, _nextTile = 0, _finishedTiles = 0;
+        UnsignedInt _activeTiles = 0;
+        /* Tiles rendered in the current pass. A converged tile is flagged by
+           the worker that rendered it and dropped when the pass ends. */
+        std::vector<UnsignedInt> _passTiles;
+        std::vector<UnsignedByte> _tileConverged;
+        std::atomic<bool> _cancel{false}, _done{false};
+        std::atomic<UnsignedInt> _completedPasses{0}, _convergedTiles{0};
+
+        /* Handoff of finished tiles, guarded by _tileUpdatesMutex. Pixel
+           arrays are recycled through the free list, for each tile there's
+           an index of its update in the queue or -1. */
+        std::mutex _tileUpdatesMutex;
+        std::vector<TileUpdate> _tileUpdates, _freeTileUpdates;
+        std::vector<Int> _pendingTileUpdates;
+        std::vector<TileUpdate> _displayedTileUpdates;
 
-        bool _markNextBlock = true;
-        std::atomic<bool> _busy{false};
+        std::atomic<bool> _markTiles{true}, _handOverTiles{true};
+        std::atomic<UnsignedLong> _samplesTraced{0}, _raysTraced{0}, _nodesVisited{0};
 };
 
 }}
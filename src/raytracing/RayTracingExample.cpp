@@ -29,7 +29,10 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <ctime>
 #include <Corrade/Containers/Pointer.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/PluginManager/Manager.h>
 #include <Corrade/Utility/Arguments.h>
 #include <Corrade/Utility/FormatStl.h>
 #include <Magnum/GL/DefaultFramebuffer.h>
@@ -40,6 +43,7 @@
 #include <Magnum/ImageView.h>
 #include <Magnum/PixelFormat.h>
 #include <Magnum/Platform/Sdl2Application.h>
+#include <Magnum/Trade/AbstractImporter.h>
 
 #include "../arcball/ArcBall.h"
 #include "RayTracer.h"
@@ -61,7 +65,7 @@ class RayTracingExample: public Platform::Application {
         void pointerMoveEvent(PointerMoveEvent& event) override;
         void scrollEvent(ScrollEvent& event) override;
 
-        void renderAndUpdateBlockPixels();
+        void updatePixels();
         void resizeBuffers(const Vector2i& bufferSize);
         void updateRayTracerCamera();
 
@@ -72,6 +76,7 @@ class RayTracingExample: public Platform::Application {
         Containers::Pointer<RayTracer> _rayTracer;
         bool _depthOfField = false;
         bool _paused = false;
+        UnsignedInt _displayedIteration = ~UnsignedInt{};
 };
 
 RayTracingExample::RayTracingExample(const Arguments& arguments):
@@ -84,6 +89,16 @@ RayTracingExample::RayTracingExample(const Arguments& arguments):
             .setHelp("max-samples", "max samples per pixel", "COUNT")
         .addOption("max-ray-depth", "16")
             .setHelp("max-ray-depth", "max ray depth", "DEPTH")
+        .addOption("threads", "0")
+            .setHelp("threads", "count of render threads, 0 for all hardware threads", "COUNT")
+        .addOption("adaptive-threshold", "0.02")
+            .setHelp("adaptive-threshold", "stop sampling tiles with relative error below this, 0 to disable", "ERROR")
+        .addOption("adaptive-min-samples", "16")
+            .setHelp("adaptive-min-samples", "min samples per pixel before a tile can converge", "COUNT")
+        .addOption("import")
+            .setHelp("import", "scene file to render instead of the generated spheres", "FILE")
+        .addOption("importer", "AnySceneImporter")
+            .setHelp("importer", "importer plugin to use")
         .addSkippedPrefix("magnum")
         .parse(arguments.argc, arguments.argv);
 
@@ -104,7 +119,22 @@ RayTracingExample::RayTracingExample(const Arguments& arguments):
             Vector2{framebufferSize()}.aspectRatio(), 0.0f, framebufferSize(),
             args.value<UnsignedInt>("block-size"),
             args.value<UnsignedInt>("max-samples"),
-            args.value<UnsignedInt>("max-ray-depth"));
+            args.value<UnsignedInt>("max-ray-depth"),
+            UnsignedInt(std::time(nullptr)),
+            args.value<UnsignedInt>("threads"));
+        _rayTracer->setAdaptiveSampling(
+            args.value<Float>("adaptive-threshold"),
+            args.value<UnsignedInt>("adaptive-min-samples"));
+        _rayTracer->setReprojection(true);
+
+        if(!args.value("import").isEmpty()) {
+            PluginManager::Manager<Trade::AbstractImporter> manager;
+            Containers::Pointer<Trade::AbstractImporter> importer =
+                manager.loadAndInstantiate(args.value("importer"));
+            if(!importer || !importer->openFile(args.value("import")) ||
+               !_rayTracer->importScene(*importer))
+                std::exit(1);
+        }
         resizeBuffers(framebufferSize());
     }
 
@@ -121,21 +151,27 @@ void RayTracingExample::drawEvent() {
     if(_arcballCamera->updateTransformation())
         updateRayTracerCamera();
 
-    /* Render a block of pixels */
-    renderAndUpdateBlockPixels();
+    /* Display tiles finished by the ray tracer since last frame. If it was
+       done already before, everything it rendered is there. */
+    const bool done = _rayTracer->done();
+    const bool updated = _rayTracer->update();
+    if(updated) updatePixels();
     swapBuffers();
 
     /* Draw again if the raytracer is not done with all samples yet */
-    if(!_rayTracer->done()) redraw();
+    if(!done || updated) redraw();
 }
 
-void RayTracingExample::renderAndUpdateBlockPixels() {
+void RayTracingExample::updatePixels() {
     /* Update window title with current iteration index */
-    if(_rayTracer->currentBlock() == Vector2i{}) setWindowTitle(
-        Utility::formatString("Magnum Ray Tracing Example (iteration {})",
-            _rayTracer->iteration() + 2));
+    if(_rayTracer->iteration() != _displayedIteration) {
+        _displayedIteration = _rayTracer->iteration();
+        setWindowTitle(Utility::formatString(
+            "Magnum Ray Tracing Example (iteration {}, {} of {} tiles converged, {:.1f} BVH nodes per ray)",
+            _displayedIteration + 1, _rayTracer->convergedTiles(),
+            _rayTracer->tileCount(), _rayTracer->nodesVisitedPerRay()));
+    }
 
-    _rayTracer->renderBlock();
     const auto& pixels = _rayTracer->renderedBuffer();
     _texture.setSubImage(0, {},
         ImageView2D(PixelFormat::RGBA8Unorm, framebufferSize(), pixels));
@@ -169,16 +205,24 @@ void RayTracingExample::keyPressEvent(KeyEvent& event) {
             break;
 
         case Key::M:
-            _rayTracer->markNextBlock() ^= true;
+            _rayTracer->setMarkTiles(!_rayTracer->markTiles());
             break;
 
         case Key::N:
             _rayTracer->generateSceneObjects();
-            _rayTracer->clearBuffers();
+            break;
+
+        case Key::P:
+            _rayTracer->setReprojection(!_rayTracer->reprojection());
+            if(_rayTracer->reprojection())
+                Debug{} << "Reprojection enabled";
+            else
+                Debug{} << "Reprojection disabled";
             break;
 
         case Key::Space:
             _paused ^= true;
+            _rayTracer->setPaused(_paused);
             break;
 
         default:
@@ -31,35 +31,157 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include <cstdlib>
+#include <cmath>
 #include <Magnum/Magnum.h>
+#include <Magnum/Math/Constants.h>
+#include <Magnum/Math/Functions.h>
 #include <Magnum/Math/Vector2.h>
 #include <Magnum/Math/Vector3.h>
 
 namespace Magnum { namespace Examples { namespace Rnd {
 
+/* PCG32 generator, https://www.pcg-random.org/. Small state, fast and with
+   independent streams. */
+class Pcg32 {
+    public:
+        void seed(UnsignedLong seed, UnsignedLong stream) {
+            _state = 0;
+            _increment = (stream << 1) | 1;
+            next();
+            _state += seed;
+            next();
+        }
+
+        UnsignedInt next() {
+            const UnsignedLong old = _state;
+            _state = old*6364136223846793005ull + _increment;
+            const UnsignedInt xorShifted = UnsignedInt(((old >> 18) ^ old) >> 27);
+            const UnsignedInt rotation = UnsignedInt(old >> 59);
+            return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+        }
+
+    private:
+        UnsignedLong _state = 0x853c49e6748fea9bull;
+        UnsignedLong _increment = 0xda3e39cb94b95bdbull;
+};
+
+/* Each thread has its own generator state. Only the scene generation uses
+   it, the render workers take all their samples from a Sampler. */
+inline Pcg32& generator() {
+    thread_local Pcg32 generator;
+    return generator;
+}
+
+inline void seed(UnsignedInt seed, UnsignedInt stream = 0) {
+    generator().seed(seed, stream);
+}
+
+/* Uses the top 24 bits so the result is exactly representable and never
+   reaches 1 */
+inline Float toUnitFloat(UnsignedInt bits) {
+    return (bits >> 8)*(1.0f/16777216.0f);
+}
+
 inline Float rand01() {
-    return rand() / Float(Float(RAND_MAX) + 1.0f);
+    return toUnitFloat(generator().next());
 }
 
-inline Vector2 rndInDisk() {
-    Vector2 p;
+/* Integer hash with good avalanche, https://nullprogram.com/blog/2018/07/31/ */
+inline UnsignedInt hash(UnsignedInt x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
 
-    do p = 2.0f*Vector2{rand01(), rand01()} - Vector2{1.0f, 1.0f};
-    while(Math::dot(p, p) >= 1.0f);
+/* Sample mappings. These map a uniformly distributed point in the unit
+   square directly instead of rejection sampling, which keeps stratification
+   of the input samples and doesn't loop. */
+
+/* Shirley-Chiu concentric mapping */
+inline Vector2 rndInDisk(const Vector2& u) {
+    const Vector2 offset = 2.0f*u - Vector2{1.0f};
+    if(offset.x() == 0.0f && offset.y() == 0.0f) return {};
+
+    Float r;
+    Rad theta;
+    if(Math::abs(offset.x()) > Math::abs(offset.y())) {
+        r = offset.x();
+        theta = Rad{Constants::piQuarter()*(offset.y()/offset.x())};
+    } else {
+        r = offset.y();
+        theta = Rad{Constants::piHalf() - Constants::piQuarter()*(offset.x()/offset.y())};
+    }
+
+    return r*Vector2{Math::cos(theta), Math::sin(theta)};
+}
 
-    return p;
+inline Vector3 randomOnSphere(const Vector2& u) {
+    const Float z = 1.0f - 2.0f*u.x();
+    const Float r = Math::sqrt(Math::max(0.0f, 1.0f - z*z));
+    const Rad phi{2.0f*Constants::pi()*u.y()};
+    return {r*Math::cos(phi), r*Math::sin(phi), z};
 }
 
-inline Vector3 randomInSphere() {
-    Vector3 p;
+/* The third uniform variate picks the distance from the center, with the
+   cube root making the points uniformly distributed in the volume */
+inline Vector3 randomInSphere(const Vector2& u, Float u3) {
+    return randomOnSphere(u)*std::cbrt(u3);
+}
 
-    do p = 2.0f*Vector3{rand01(), rand01(), rand01()} - Vector3{1.0f, 1.0f, 1.0f};
-    while(Math::dot(p, p) >= 1.0f);
+/* Bit-reversed index, which is the first dimension of the Sobol sequence */
+inline UnsignedInt reverseBits(UnsignedInt x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
 
-    return p;
+/* Second dimension of the Sobol sequence */
+inline UnsignedInt sobol2(UnsignedInt index) {
+    UnsignedInt result = 0;
+    for(UnsignedInt v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+        if(index & 1) result ^= v;
+    return result;
 }
 
+/* Low-discrepancy samples for one pixel and one pass. Each pair of
+   dimensions is taken from the 2D Sobol (0, 2)-sequence indexed by the pass,
+   so the samples of a pixel stay stratified over any power-of-two count of
+   passes. The index and the digits are scrambled by a hash of the pixel and
+   the dimension, which keeps the stratification while decorrelating pixels
+   and dimensions from each other, turning the structured error into
+   high-frequency noise. */
+class Sampler {
+    public:
+        explicit Sampler(UnsignedInt pixel, UnsignedInt sampleIndex):
+            _seed{hash(pixel)}, _sampleIndex{sampleIndex} {}
+
+        Vector2 next2D() {
+            const UnsignedInt seed = hash(_seed ^ hash(_dimension++));
+            const UnsignedInt index = _sampleIndex ^ (seed & IndexScrambleMask);
+            const UnsignedInt scrambleX = hash(seed + 1);
+            const UnsignedInt scrambleY = hash(seed + 2);
+            return {toUnitFloat(reverseBits(index) ^ scrambleX),
+                    toUnitFloat(sobol2(index) ^ scrambleY)};
+        }
+
+        Float next1D() { return next2D().x(); }
+
+    private:
+        /* Keeps the scrambled index small enough to not run out of the
+           sequence precision */
+        enum: UnsignedInt { IndexScrambleMask = 0xffff };
+
+        UnsignedInt _seed;
+        UnsignedInt _sampleIndex;
+        UnsignedInt _dimension = 0;
+};
+
 }}}
 
 #endif
@@ -0,0 +1,236 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2020 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Magnum/Math/Constants.h>
+#include <Magnum/Math/Functions.h>
+
+#ifdef CORRADE_TARGET_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "SphereSet.h"
+#include "Ray.h"
+
+namespace Magnum { namespace Examples {
+
+namespace {
+
+/* Spreads lower 10 bits so there are two zero bits between each */
+inline UnsignedInt spreadBits(UnsignedInt x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+}
+
+ObjectList SphereSet::clusters(Containers::ArrayView<const Item> spheres,
+    UnsignedInt setSize)
+{
+    ObjectList sets;
+    if(spheres.isEmpty()) return sets;
+
+    /* Spheres much larger than the median would inflate bounds of any set
+       they're in, so they get a set of their own */
+    Containers::Array<Float> radii{spheres.size()};
+    for(std::size_t i = 0; i != spheres.size(); ++i)
+        radii[i] = spheres[i].radius;
+    std::nth_element(radii.begin(), radii.begin() + radii.size()/2, radii.end());
+    const Float largeRadius = 8.0f*radii[radii.size()/2];
+
+    Containers::Array<Item> small;
+    Range3D centerBounds;
+    for(const Item& sphere: spheres) {
+        if(sphere.radius > largeRadius) {
+            sets.addObject(Containers::pointer<SphereSet>(
+                Containers::arrayView(&sphere, 1)));
+            continue;
+        }
+
+        centerBounds = small.isEmpty() ?
+            Range3D{sphere.center, sphere.center} :
+            Math::join(centerBounds, Range3D{sphere.center, sphere.center});
+        arrayAppend(small, sphere);
+    }
+
+    /* Sort the rest along a Morton curve and cut it into consecutive runs,
+       which keeps each set spatially compact */
+    const Vector3 size = centerBounds.size();
+    const Vector3 scale{size.x() > 0.0f ? 1023.0f/size.x() : 0.0f,
+                        size.y() > 0.0f ? 1023.0f/size.y() : 0.0f,
+                        size.z() > 0.0f ? 1023.0f/size.z() : 0.0f};
+    const auto mortonCode = [&](const Item& sphere) {
+        const Vector3 p = (sphere.center - centerBounds.min())*scale;
+        return spreadBits(UnsignedInt(p.x())) |
+               spreadBits(UnsignedInt(p.y())) << 1 |
+               spreadBits(UnsignedInt(p.z())) << 2;
+    };
+    std::sort(small.begin(), small.end(), [&](const Item& a, const Item& b) {
+        return mortonCode(a) < mortonCode(b);
+    });
+
+    for(std::size_t i = 0; i < small.size(); i += setSize)
+        sets.addObject(Containers::pointer<SphereSet>(
+            small.slice(i, Math::min(i + setSize, small.size()))));
+
+    return sets;
+}
+
+SphereSet::SphereSet(Containers::ArrayView<const Item> spheres) {
+    const std::size_t paddedSize = (spheres.size() + 3) & ~std::size_t(3);
+    _centersX = Containers::Array<Float>{paddedSize};
+    _centersY = Containers::Array<Float>{paddedSize};
+    _centersZ = Containers::Array<Float>{paddedSize};
+    _radiiSqr = Containers::Array<Float>{paddedSize};
+    _materialIds = Containers::Array<UnsignedInt>{spheres.size()};
+
+    for(std::size_t i = 0; i != spheres.size(); ++i) {
+        const Item& sphere = spheres[i];
+        _centersX[i] = sphere.center.x();
+        _centersY[i] = sphere.center.y();
+        _centersZ[i] = sphere.center.z();
+        _radiiSqr[i] = sphere.radius*sphere.radius;
+        _materialIds[i] = sphere.materialId;
+
+        const Range3D bounds = Range3D::fromCenter(sphere.center, Vector3{sphere.radius});
+        _bounds = i ? Math::join(_bounds, bounds) : bounds;
+    }
+
+    /* NaN makes all comparisons in the intersection false, so the padding
+       is never hit */
+    for(std::size_t i = spheres.size(); i != paddedSize; ++i) {
+        _centersX[i] = _centersY[i] = _centersZ[i] = Constants::nan();
+        _radiiSqr[i] = 0.0f;
+    }
+}
+
+bool SphereSet::intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const {
+    /* For each sphere the closer root if it's in range and the farther one
+       otherwise, done for all spheres at once, keeping the closest hit */
+    Float closestT = tMax;
+    Int closest = -1;
+
+    #ifdef CORRADE_TARGET_SSE2
+    const __m128 originX = _mm_set1_ps(r.origin.x());
+    const __m128 originY = _mm_set1_ps(r.origin.y());
+    const __m128 originZ = _mm_set1_ps(r.origin.z());
+    const __m128 directionX = _mm_set1_ps(r.unitDirection.x());
+    const __m128 directionY = _mm_set1_ps(r.unitDirection.y());
+    const __m128 directionZ = _mm_set1_ps(r.unitDirection.z());
+    const __m128 minT = _mm_set1_ps(tMin);
+    const __m128 zero = _mm_setzero_ps();
+
+    /* Each lane keeps its own closest hit */
+    __m128 laneT = _mm_set1_ps(tMax);
+    __m128i laneIndex = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i four = _mm_set1_epi32(4);
+
+    for(std::size_t i = 0; i != _radiiSqr.size(); i += 4) {
+        const __m128 ocX = _mm_sub_ps(originX, _mm_loadu_ps(_centersX.data() + i));
+        const __m128 ocY = _mm_sub_ps(originY, _mm_loadu_ps(_centersY.data() + i));
+        const __m128 ocZ = _mm_sub_ps(originZ, _mm_loadu_ps(_centersZ.data() + i));
+        const __m128 b = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(directionX, ocX),
+            _mm_mul_ps(directionY, ocY)),
+            _mm_mul_ps(directionZ, ocZ));
+        const __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(ocX, ocX),
+            _mm_mul_ps(ocY, ocY)),
+            _mm_mul_ps(ocZ, ocZ)),
+            _mm_loadu_ps(_radiiSqr.data() + i));
+        const __m128 delta = _mm_sub_ps(_mm_mul_ps(b, b), c);
+        const __m128 hasRoots = _mm_cmpgt_ps(delta, zero);
+        const __m128 sqrtDelta = _mm_sqrt_ps(_mm_max_ps(delta, zero));
+        const __m128 minusB = _mm_sub_ps(zero, b);
+        const __m128 t1 = _mm_sub_ps(minusB, sqrtDelta);
+        const __m128 t2 = _mm_add_ps(minusB, sqrtDelta);
+
+        const __m128 hit1 = _mm_and_ps(hasRoots,
+            _mm_and_ps(_mm_cmpgt_ps(t1, minT), _mm_cmplt_ps(t1, laneT)));
+        const __m128 hit2 = _mm_and_ps(hasRoots,
+            _mm_and_ps(_mm_cmpgt_ps(t2, minT), _mm_cmplt_ps(t2, laneT)));
+        const __m128 t = _mm_or_ps(_mm_and_ps(hit1, t1), _mm_andnot_ps(hit1, t2));
+        const __m128 hit = _mm_or_ps(hit1, hit2);
+        const __m128i hitMask = _mm_castps_si128(hit);
+
+        laneT = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, laneT));
+        laneIndex = _mm_or_si128(_mm_and_si128(hitMask, index),
+            _mm_andnot_si128(hitMask, laneIndex));
+        index = _mm_add_epi32(index, four);
+    }
+
+    alignas(16) Float laneTs[4];
+    alignas(16) Int laneIndices[4];
+    _mm_store_ps(laneTs, laneT);
+    _mm_store_si128(reinterpret_cast<__m128i*>(laneIndices), laneIndex);
+    for(std::size_t lane = 0; lane != 4; ++lane) {
+        if(laneIndices[lane] != -1 && laneTs[lane] < closestT) {
+            closestT = laneTs[lane];
+            closest = laneIndices[lane];
+        }
+    }
+    #else
+    for(std::size_t i = 0; i != _materialIds.size(); ++i) {
+        const Vector3 oc = r.origin - Vector3{_centersX[i], _centersY[i], _centersZ[i]};
+        const Float b = Math::dot(r.unitDirection, oc);
+        const Float c = Math::dot(oc, oc) - _radiiSqr[i];
+        const Float delta = b*b - c;
+        if(!(delta > 0.0f)) continue;
+
+        const Float sqrtDelta = Math::sqrt(delta);
+        const Float t1 = -b - sqrtDelta;
+        const Float t2 = -b + sqrtDelta;
+        const Float t = t1 > tMin ? t1 : t2;
+        if(t > tMin && t < closestT) {
+            closestT = t;
+            closest = Int(i);
+        }
+    }
+    #endif
+
+    if(closest == -1) return false;
+
+    const std::size_t i = closest;
+    const Vector3 center{_centersX[i], _centersY[i], _centersZ[i]};
+    hitInfo.t = closestT;
+    hitInfo.p = r.point(closestT);
+    hitInfo.unitNormal = (hitInfo.p - center).normalized();
+    hitInfo.materialId = _materialIds[i];
+    return true;
+}
+
+}}
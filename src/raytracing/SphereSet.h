@@ -0,0 +1,76 @@
+#ifndef Magnum_Examples_RayTracing_SphereSet_h
+#define Magnum_Examples_RayTracing_SphereSet_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2020 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+
+#include "Objects.h"
+
+namespace Magnum { namespace Examples {
+
+/* A group of spheres stored as a structure of arrays. All spheres in the
+   set are tested against a ray at once, four at a time with SSE2 if
+   available, without any virtual call per sphere. Meant to be used as BVH
+   leaves, see clusters(). */
+class SphereSet: public Object {
+    public:
+        struct Item {
+            Vector3 center;
+            Float radius;
+            /* Index into the scene material array */
+            UnsignedInt materialId;
+        };
+
+        /* Splits the spheres into sets of at most setSize spheres close to
+           each other, with spheres much larger than the rest put in sets of
+           their own */
+        static ObjectList clusters(Containers::ArrayView<const Item> spheres,
+            UnsignedInt setSize = 8);
+
+        explicit SphereSet(Containers::ArrayView<const Item> spheres);
+
+        bool intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const override;
+        Range3D bounds() const override { return _bounds; }
+
+        std::size_t size() const { return _materialIds.size(); }
+
+    private:
+        /* Padded to a multiple of four with spheres that never get hit */
+        Containers::Array<Float> _centersX, _centersY, _centersZ, _radiiSqr;
+        Containers::Array<UnsignedInt> _materialIds;
+        Range3D _bounds;
+};
+
+}}
+
+#endif
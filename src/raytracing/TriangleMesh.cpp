@@ -0,0 +1,205 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2020 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <utility>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Magnum/Math/Functions.h>
+
+#include "TriangleMesh.h"
+#include "BVH.h"
+#include "Ray.h"
+
+namespace Magnum { namespace Examples {
+
+namespace {
+
+/* Spreads lower 10 bits so there are two zero bits between each */
+inline UnsignedInt spreadBits(UnsignedInt x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+}
+
+TriangleSet::TriangleSet(Containers::ArrayView<const Vector3> vertices): _vertices{NoInit, vertices.size()} {
+    for(std::size_t i = 0; i != vertices.size(); ++i) {
+        _vertices[i] = vertices[i];
+        _bounds = i ? Math::join(_bounds, Range3D{vertices[i], vertices[i]}) :
+            Range3D{vertices[i], vertices[i]};
+    }
+}
+
+bool TriangleSet::intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const {
+    /* Permute the axes so the ray goes mostly along Z and shear them so it
+       goes exactly along Z. That's the same for all triangles. */
+    const Vector3 absDirection = Math::abs(r.unitDirection);
+    const UnsignedInt kz = absDirection.x() > absDirection.y() ?
+        (absDirection.x() > absDirection.z() ? 0 : 2) :
+        (absDirection.y() > absDirection.z() ? 1 : 2);
+    UnsignedInt kx = (kz + 1)%3;
+    UnsignedInt ky = (kx + 1)%3;
+    if(r.unitDirection[kz] < 0.0f) std::swap(kx, ky);
+    const Float sz = 1.0f/r.unitDirection[kz];
+    const Float sx = r.unitDirection[kx]*sz;
+    const Float sy = r.unitDirection[ky]*sz;
+
+    Float closestT = tMax;
+    std::size_t closest = ~std::size_t{};
+    for(std::size_t i = 0; i != _vertices.size(); i += 3) {
+        const Vector3 a = _vertices[i + 0] - r.origin;
+        const Vector3 b = _vertices[i + 1] - r.origin;
+        const Vector3 c = _vertices[i + 2] - r.origin;
+        const Float ax = a[kx] - sx*a[kz];
+        const Float ay = a[ky] - sy*a[kz];
+        const Float bx = b[kx] - sx*b[kz];
+        const Float by = b[ky] - sy*b[kz];
+        const Float cx = c[kx] - sx*c[kz];
+        const Float cy = c[ky] - sy*c[kz];
+
+        /* Scaled barycentrics. If the ray goes exactly through an edge,
+           recalculate them with doubles, so the decision is consistent for
+           both triangles sharing the edge. */
+        Float u = cx*by - cy*bx;
+        Float v = ax*cy - ay*cx;
+        Float w = bx*ay - by*ax;
+        if(u == 0.0f || v == 0.0f || w == 0.0f) {
+            u = Float(Double(cx)*Double(by) - Double(cy)*Double(bx));
+            v = Float(Double(ax)*Double(cy) - Double(ay)*Double(cx));
+            w = Float(Double(bx)*Double(ay) - Double(by)*Double(ax));
+        }
+
+        /* Accepting both signs makes the triangles two-sided */
+        if((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+            continue;
+        const Float determinant = u + v + w;
+        if(determinant == 0.0f) continue;
+
+        const Float t = sz*(u*a[kz] + v*b[kz] + w*c[kz])/determinant;
+        if(t > tMin && t < closestT) {
+            closestT = t;
+            closest = i;
+        }
+    }
+
+    if(closest == ~std::size_t{}) return false;
+
+    Vector3 normal = Math::cross(_vertices[closest + 1] - _vertices[closest],
+        _vertices[closest + 2] - _vertices[closest]).normalized();
+    if(Math::dot(normal, r.unitDirection) > 0.0f) normal = -normal;
+    hitInfo.t = closestT;
+    hitInfo.p = r.point(closestT);
+    hitInfo.unitNormal = normal;
+    return true;
+}
+
+TriangleMesh::TriangleMesh(Containers::ArrayView<const Vector3> positions,
+    Containers::ArrayView<const UnsignedInt> indices, UnsignedInt setSize):
+    _triangleCount{indices.size()/3}
+{
+    /* Sort the triangles along a Morton curve of their centroids and cut
+       them into consecutive runs, same as with SphereSet::clusters() */
+    Containers::Array<Vector3> centroids{NoInit, _triangleCount};
+    Range3D centroidBounds;
+    for(std::size_t i = 0; i != _triangleCount; ++i) {
+        centroids[i] = (positions[indices[3*i + 0]] +
+                        positions[indices[3*i + 1]] +
+                        positions[indices[3*i + 2]])/3.0f;
+        centroidBounds = i ? Math::join(centroidBounds, Range3D{centroids[i], centroids[i]}) :
+            Range3D{centroids[i], centroids[i]};
+    }
+
+    const Vector3 size = centroidBounds.size();
+    const Vector3 scale{size.x() > 0.0f ? 1023.0f/size.x() : 0.0f,
+                        size.y() > 0.0f ? 1023.0f/size.y() : 0.0f,
+                        size.z() > 0.0f ? 1023.0f/size.z() : 0.0f};
+    Containers::Array<std::pair<UnsignedInt, UnsignedInt>> order{NoInit, _triangleCount};
+    for(std::size_t i = 0; i != _triangleCount; ++i) {
+        const Vector3 p = (centroids[i] - centroidBounds.min())*scale;
+        order[i] = {spreadBits(UnsignedInt(p.x())) |
+                    spreadBits(UnsignedInt(p.y())) << 1 |
+                    spreadBits(UnsignedInt(p.z())) << 2, UnsignedInt(i)};
+    }
+    std::sort(order.begin(), order.end());
+
+    ObjectList sets;
+    Containers::Array<Vector3> vertices;
+    for(std::size_t i = 0; i < _triangleCount; i += setSize) {
+        arrayResize(vertices, 0);
+        for(std::size_t j = i, end = Math::min(i + setSize, _triangleCount); j != end; ++j)
+            for(UnsignedInt k = 0; k != 3; ++k)
+                arrayAppend(vertices, positions[indices[3*order[j].second + k]]);
+        sets.addObject(Containers::pointer<TriangleSet>(vertices));
+    }
+
+    _bvh = Containers::pointer<BVH>(std::move(sets));
+}
+
+TriangleMesh::~TriangleMesh() = default;
+
+MeshInstance::MeshInstance(const TriangleMesh& mesh,
+    const Matrix4& transformation, UnsignedInt materialId): _mesh(mesh),
+    _invertedTransformation{transformation.inverted()},
+    _normalMatrix{transformation.normalMatrix()}, _materialId{materialId}
+{
+    /* Bounds of the transformed corners of the mesh bounds */
+    const Range3D meshBounds = mesh.bvh().bounds();
+    for(UnsignedInt i = 0; i != 8; ++i) {
+        const Vector3 corner = transformation.transformPoint({
+            (i & 1 ? meshBounds.max() : meshBounds.min()).x(),
+            (i & 2 ? meshBounds.max() : meshBounds.min()).y(),
+            (i & 4 ? meshBounds.max() : meshBounds.min()).z()});
+        _bounds = i ? Math::join(_bounds, Range3D{corner, corner}) :
+            Range3D{corner, corner};
+    }
+}
+
+bool MeshInstance::intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const {
+    /* The transformation may contain scaling, so distances along the ray
+       change by the length of the transformed direction */
+    const Vector3 direction = _invertedTransformation.transformVector(r.unitDirection);
+    const Float scale = direction.length();
+    const Ray objectRay{_invertedTransformation.transformPoint(r.origin), direction};
+    if(!_mesh.bvh().intersectNested(objectRay, tMin*scale, tMax*scale, hitInfo))
+        return false;
+
+    hitInfo.t /= scale;
+    hitInfo.p = r.point(hitInfo.t);
+    hitInfo.unitNormal = (_normalMatrix*hitInfo.unitNormal).normalized();
+    hitInfo.materialId = _materialId;
+    return true;
+}
+
+}}
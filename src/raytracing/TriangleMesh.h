@@ -0,0 +1,102 @@
+#ifndef Magnum_Examples_RayTracing_TriangleMesh_h
+#define Magnum_Examples_RayTracing_TriangleMesh_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2020 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Containers/Pointer.h>
+#include <Magnum/Math/Matrix3.h>
+#include <Magnum/Math/Matrix4.h>
+
+#include "Objects.h"
+
+namespace Magnum { namespace Examples {
+
+class BVH;
+
+/* A group of triangles tested against a ray with the watertight algorithm
+   by Woop, Benthin and Wald, so rays never slip through shared edges. Meant
+   to be used as BVH leaves, see TriangleMesh. Triangles are two-sided, the
+   reported normal always faces against the ray. */
+class TriangleSet: public Object {
+    public:
+        /* Three vertices for each triangle */
+        explicit TriangleSet(Containers::ArrayView<const Vector3> vertices);
+
+        bool intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const override;
+        Range3D bounds() const override { return _bounds; }
+
+    private:
+        Containers::Array<Vector3> _vertices;
+        Range3D _bounds;
+};
+
+/* Triangles of a single mesh in its own coordinate system with a bottom
+   level BVH over them, shared by all instances of the mesh */
+class TriangleMesh {
+    public:
+        explicit TriangleMesh(Containers::ArrayView<const Vector3> positions,
+            Containers::ArrayView<const UnsignedInt> indices,
+            UnsignedInt setSize = 4);
+
+        ~TriangleMesh();
+
+        const BVH& bvh() const { return *_bvh; }
+        std::size_t triangleCount() const { return _triangleCount; }
+
+    private:
+        Containers::Pointer<BVH> _bvh;
+        std::size_t _triangleCount;
+};
+
+/* A mesh placed in the scene with a transformation and a material. The top
+   level BVH is built over these, rays are transformed into the mesh
+   coordinate system instead of transforming the triangles. */
+class MeshInstance: public Object {
+    public:
+        explicit MeshInstance(const TriangleMesh& mesh,
+            const Matrix4& transformation, UnsignedInt materialId);
+
+        bool intersect(const Ray& r, Float tMin, Float tMax, HitInfo& hitInfo) const override;
+        Range3D bounds() const override { return _bounds; }
+
+    private:
+        const TriangleMesh& _mesh;
+        Matrix4 _invertedTransformation;
+        Matrix3x3 _normalMatrix;
+        UnsignedInt _materialId;
+        Range3D _bounds;
+};
+
+}}
+
+#endif
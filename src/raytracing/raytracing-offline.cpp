@@ -0,0 +1,165 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2020 — Nghia Truong <nghiatruong.vn@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Pointer.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Containers/StringView.h>
+#include <Corrade/PluginManager/Manager.h>
+#include <Corrade/Utility/Arguments.h>
+#include <Corrade/Utility/Format.h>
+#include <Magnum/ImageView.h>
+#include <Magnum/PixelFormat.h>
+#include <Magnum/Math/Color.h>
+#include <Magnum/Math/ConfigurationValue.h>
+#include <Magnum/Trade/AbstractImageConverter.h>
+#include <Magnum/Trade/AbstractImporter.h>
+
+#include "RayTracer.h"
+
+using namespace Magnum;
+using namespace Magnum::Examples;
+using namespace Math::Literals;
+
+int main(int argc, char** argv) {
+    Utility::Arguments args;
+    args.addOption("size", "1280 720")
+            .setHelp("size", "image size", "\"X Y\"")
+        .addOption("max-samples", "100")
+            .setHelp("max-samples", "samples per pixel", "COUNT")
+        .addOption("max-ray-depth", "16")
+            .setHelp("max-ray-depth", "max ray depth", "DEPTH")
+        .addOption("block-size", "64")
+            .setHelp("block-size", "size of a block rendered by a thread at a time", "PIXELS")
+        .addOption("threads", "0")
+            .setHelp("threads", "count of render threads, 0 for all hardware threads", "COUNT")
+        .addOption("adaptive-threshold", "0")
+            .setHelp("adaptive-threshold", "stop sampling tiles with relative error below this, 0 to disable", "ERROR")
+        .addOption("adaptive-min-samples", "16")
+            .setHelp("adaptive-min-samples", "min samples per pixel before a tile can converge", "COUNT")
+        .addOption("import")
+            .setHelp("import", "scene file to render instead of the generated spheres", "FILE")
+        .addOption("importer", "AnySceneImporter")
+            .setHelp("importer", "importer plugin to use")
+        .addOption("eye", "5 1 5.5")
+            .setHelp("eye", "camera position", "\"X Y Z\"")
+        .addOption("view-center", "1 0.5 0")
+            .setHelp("view-center", "point the camera looks at", "\"X Y Z\"")
+        .addOption("seed", "0")
+            .setHelp("seed", "seed for generating the scene", "SEED")
+        .addBooleanOption("depth-of-field")
+            .setHelp("depth-of-field", "enable depth of field")
+        .addOption("output", "raytracing.png")
+            .setHelp("output", "output image, linear floating-point data are saved for *.exr files", "FILE")
+        .setGlobalHelp("Renders the ray tracing example scene without a window and "
+            "reports the rendering throughput. With the same options the output is "
+            "the same each time.")
+        .parse(argc, argv);
+
+    const Vector2i size = args.value<Vector2i>("size");
+    const UnsignedInt samples = args.value<UnsignedInt>("max-samples");
+    const auto output = args.value("output");
+    const bool linear = Containers::StringView{output}.hasSuffix(".exr");
+
+    /* Load the converter upfront so a missing plugin is discovered before
+       spending time rendering */
+    PluginManager::Manager<Trade::AbstractImageConverter> manager;
+    Containers::Pointer<Trade::AbstractImageConverter> converter =
+        manager.loadAndInstantiate("AnyImageConverter");
+    if(!converter) return 1;
+
+    /* Open the scene file upfront as well, it's imported into the ray tracer
+       only after it's constructed */
+    PluginManager::Manager<Trade::AbstractImporter> importerManager;
+    Containers::Pointer<Trade::AbstractImporter> importer;
+    if(!args.value("import").isEmpty()) {
+        importer = importerManager.loadAndInstantiate(args.value("importer"));
+        if(!importer || !importer->openFile(args.value("import"))) return 3;
+    }
+
+    /* By default the same camera as in the interactive example. The workers
+       start rendering right away, pause them until the scene is final so
+       the time spent building it isn't counted as rendering time. */
+    const std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+    RayTracer rayTracer{args.value<Vector3>("eye"),
+        args.value<Vector3>("view-center"), {0.0f, 1.0f, 0.0f}, 45.0_degf,
+        Vector2{size}.aspectRatio(),
+        args.isSet("depth-of-field") ? 0.08f : 0.0f, size,
+        args.value<UnsignedInt>("block-size"), samples,
+        args.value<UnsignedInt>("max-ray-depth"),
+        args.value<UnsignedInt>("seed"),
+        args.value<UnsignedInt>("threads")};
+    rayTracer.setPaused(true);
+    /* There's no window to display the progress in, the image is resolved
+       once at the end */
+    rayTracer.setHandOverTiles(false);
+    if(importer && !rayTracer.importScene(*importer)) return 3;
+    const Double buildSeconds = std::chrono::duration<Double>(std::chrono::steady_clock::now() - buildStart).count();
+
+    /* This restarts the rendering and resets all counters, so the clock
+       starts here as well */
+    rayTracer.setAdaptiveSampling(
+        args.value<Float>("adaptive-threshold"),
+        args.value<UnsignedInt>("adaptive-min-samples"));
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    rayTracer.setPaused(false);
+    rayTracer.wait();
+    const Double seconds = std::chrono::duration<Double>(std::chrono::steady_clock::now() - start).count();
+
+    const UnsignedLong sampleCount = rayTracer.samplesTraced();
+    Utility::print("Built the scene in {:.3f} s\n", buildSeconds);
+    Utility::print("Rendered {}x{} pixels with {:.1f} samples per pixel on average in {:.3f} s\n",
+        size.x(), size.y(), Double(sampleCount)/size.product(), seconds);
+    Utility::print("  {} of {} tiles converged in {} passes\n",
+        rayTracer.convergedTiles(), rayTracer.tileCount(), rayTracer.iteration());
+    Utility::print("  {:.3f} Msamples/s, {:.3f} Mrays/s, {:.1f} BVH nodes per ray\n",
+        sampleCount/seconds*1.0e-6,
+        rayTracer.raysTraced()/seconds*1.0e-6,
+        rayTracer.nodesVisitedPerRay());
+
+    /* Floating-point formats get the linear average, the rest the same
+       gamma-corrected 8-bit data as shown in the interactive example */
+    bool saved;
+    if(linear) {
+        Containers::ArrayView<const Color4> accumulated = rayTracer.accumulatedBuffer();
+        Containers::Array<Color4> pixels{NoInit, accumulated.size()};
+        for(std::size_t i = 0; i != accumulated.size(); ++i)
+            pixels[i] = Color4{accumulated[i].rgb()/accumulated[i].a(), 1.0f};
+        saved = converter->convertToFile(ImageView2D{PixelFormat::RGBA32F, size, pixels}, output);
+    } else {
+        rayTracer.resolveBuffer();
+        saved = converter->convertToFile(ImageView2D{PixelFormat::RGBA8Unorm, size, rayTracer.renderedBuffer()}, output);
+    }
+    if(!saved) return 2;
+
+    Utility::print("Saved to {}\n", Containers::StringView{output});
+}
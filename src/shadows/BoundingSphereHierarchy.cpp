@@ -0,0 +1,168 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2016 — Bill Robinson <airbaggins@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "BoundingSphereHierarchy.h"
+
+#include <algorithm>
+#include <Corrade/Utility/Assert.h>
+#include <Magnum/Math/Functions.h>
+
+namespace Magnum { namespace Examples {
+
+namespace {
+
+constexpr UnsignedInt MaxLeafSize = 4;
+
+}
+
+void BoundingSphereHierarchy::build(const Containers::ArrayView<const Vector4> spheres) {
+    _nodes.clear();
+    _indices.resize(spheres.size());
+    for(std::size_t i = 0; i != _indices.size(); ++i)
+        _indices[i] = UnsignedInt(i);
+    if(spheres.isEmpty()) return;
+
+    /* Children are always added after their parent, so the nodes can be
+       refit in reverse order */
+    _nodes.push_back({{}, 0, UnsignedInt(spheres.size()), 0});
+    for(std::size_t i = 0; i != _nodes.size(); ++i) {
+        const UnsignedInt first = _nodes[i].first;
+        const UnsignedInt count = _nodes[i].count;
+        if(count <= MaxLeafSize) continue;
+
+        Range3D centreBounds{spheres[_indices[first]].xyz(), spheres[_indices[first]].xyz()};
+        for(UnsignedInt j = first + 1; j != first + count; ++j)
+            centreBounds = Math::join(centreBounds, Range3D{spheres[_indices[j]].xyz(), spheres[_indices[j]].xyz()});
+
+        const Vector3 size = centreBounds.size();
+        const std::size_t axis = size.x() > size.y() ?
+            (size.x() > size.z() ? 0 : 2) :
+            (size.y() > size.z() ? 1 : 2);
+        const UnsignedInt half = count/2;
+        std::nth_element(_indices.begin() + first, _indices.begin() + first + half, _indices.begin() + first + count, [&](UnsignedInt a, UnsignedInt b) {
+            return spheres[a][axis] < spheres[b][axis];
+        });
+
+        _nodes[i].child = UnsignedInt(_nodes.size());
+        _nodes.push_back({{}, first, half, 0});
+        _nodes.push_back({{}, first + half, count - half, 0});
+    }
+
+    refit(spheres);
+}
+
+void BoundingSphereHierarchy::refit(const Containers::ArrayView<const Vector4> spheres) {
+    CORRADE_INTERNAL_ASSERT(spheres.size() == _indices.size());
+
+    for(std::size_t i = _nodes.size(); i-- != 0; ) {
+        Node& node = _nodes[i];
+        if(node.child) {
+            node.bounds = Math::join(_nodes[node.child].bounds, _nodes[node.child + 1].bounds);
+            continue;
+        }
+
+        const Vector4& sphere = spheres[_indices[node.first]];
+        node.bounds = {sphere.xyz() - Vector3{sphere.w()}, sphere.xyz() + Vector3{sphere.w()}};
+        for(UnsignedInt j = node.first + 1; j != node.first + node.count; ++j) {
+            const Vector4& sphere = spheres[_indices[j]];
+            node.bounds = Math::join(node.bounds, Range3D{sphere.xyz() - Vector3{sphere.w()}, sphere.xyz() + Vector3{sphere.w()}});
+        }
+    }
+}
+
+UnsignedInt BoundingSphereHierarchy::cull(const Containers::ArrayView<const Vector4> planes, const Containers::ArrayView<const Vector4> spheres, std::vector<UnsignedInt>& visible) {
+    CORRADE_INTERNAL_ASSERT(planes.size() <= 32 && spheres.size() == _indices.size());
+    if(_nodes.empty()) return 0;
+
+    UnsignedInt culled = 0;
+    _stack.clear();
+    _stack.emplace_back(0, planes.size() == 32 ? ~0u : (1u << planes.size()) - 1);
+    while(!_stack.empty()) {
+        const Node& node = _nodes[_stack.back().first];
+        UnsignedInt planeMask = _stack.back().second;
+        _stack.pop_back();
+
+        /* Test the box corners farthest along and against each plane normal.
+           If the farther is outside, the whole node is; if the nearer is
+           inside, children don't need to be tested against this plane. */
+        bool outside = false;
+        for(std::size_t i = 0; i != planes.size(); ++i) {
+            if(!(planeMask & (1u << i))) continue;
+
+            const Vector3 normal = planes[i].xyz();
+            const Vector3 farthest = Math::lerp(node.bounds.min(), node.bounds.max(), normal >= Vector3{0.0f});
+            if(Math::dot(normal, farthest) + planes[i].w() < 0.0f) {
+                outside = true;
+                break;
+            }
+
+            const Vector3 nearest = Math::lerp(node.bounds.max(), node.bounds.min(), normal >= Vector3{0.0f});
+            if(Math::dot(normal, nearest) + planes[i].w() >= 0.0f)
+                planeMask &= ~(1u << i);
+        }
+
+        if(outside) {
+            culled += node.count;
+            continue;
+        }
+
+        /* Fully inside, accept everything */
+        if(!planeMask) {
+            visible.insert(visible.end(), _indices.begin() + node.first, _indices.begin() + node.first + node.count);
+            continue;
+        }
+
+        if(node.child) {
+            _stack.emplace_back(node.child, planeMask);
+            _stack.emplace_back(node.child + 1, planeMask);
+            continue;
+        }
+
+        /* Leaf intersecting some planes, test the spheres themselves */
+        for(UnsignedInt j = node.first; j != node.first + node.count; ++j) {
+            const Vector4& sphere = spheres[_indices[j]];
+            bool sphereOutside = false;
+            for(std::size_t i = 0; i != planes.size(); ++i) {
+                if((planeMask & (1u << i)) && Math::dot(planes[i], Vector4{sphere.xyz(), 1.0f}) < -sphere.w()) {
+                    sphereOutside = true;
+                    break;
+                }
+            }
+
+            if(sphereOutside) ++culled;
+            else visible.push_back(_indices[j]);
+        }
+    }
+
+    return culled;
+}
+
+}}
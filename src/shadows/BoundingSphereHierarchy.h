@@ -0,0 +1,105 @@
+#ifndef Magnum_Examples_Shadows_BoundingSphereHierarchy_h
+#define Magnum_Examples_Shadows_BoundingSphereHierarchy_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2016 — Bill Robinson <airbaggins@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <utility>
+#include <vector>
+#include <Corrade/Containers/ArrayView.h>
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/Math/Vector4.h>
+
+namespace Magnum { namespace Examples {
+
+/**
+@brief Bounding volume hierarchy over bounding spheres
+
+Used for culling shadow casters against the frustum of each shadow map layer.
+The spheres are passed with the centre in XYZ and radius in W.
+*/
+class BoundingSphereHierarchy {
+    public:
+        /**
+         * @brief Build the hierarchy
+         *
+         * Splits the spheres at the median along the longest axis of their
+         * centres until there's at most four of them in a node.
+         */
+        void build(Containers::ArrayView<const Vector4> spheres);
+
+        /**
+         * @brief Refit the hierarchy to moved spheres
+         *
+         * Updates node bounds without changing the tree structure, which is
+         * much faster than @ref build() but gets less efficient the more the
+         * spheres moved since. Expects the same sphere count as passed to
+         * @ref build().
+         */
+        void refit(Containers::ArrayView<const Vector4> spheres);
+
+        /** @brief Count of spheres in the hierarchy */
+        std::size_t size() const { return _indices.size(); }
+
+        /**
+         * @brief Cull the spheres with a set of planes
+         * @param[in] planes    Planes with normals pointing inside
+         * @param[in] spheres   Spheres the hierarchy was built or refit with
+         * @param[out] visible  Indices of spheres that aren't fully outside of
+         *      any plane get appended here
+         * @return Count of spheres that were culled
+         *
+         * Subtrees that are fully outside of a plane are skipped, subtrees
+         * fully inside all planes are accepted without further tests. At most
+         * 32 planes are supported.
+         */
+        UnsignedInt cull(Containers::ArrayView<const Vector4> planes, Containers::ArrayView<const Vector4> spheres, std::vector<UnsignedInt>& visible);
+
+    private:
+        struct Node {
+            Range3D bounds;
+            /* Range in _indices covered by this node and its children */
+            UnsignedInt first, count;
+            /* Index of the first of two children, zero for a leaf as the root
+               can't be a child */
+            UnsignedInt child;
+        };
+
+        std::vector<Node> _nodes;
+        std::vector<UnsignedInt> _indices;
+        /* Traversal stack for cull(), node index and mask of planes the node
+           intersects */
+        std::vector<std::pair<UnsignedInt, UnsignedInt>> _stack;
+};
+
+}}
+
+#endif
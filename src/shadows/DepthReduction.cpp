@@ -0,0 +1,135 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2016 — Bill Robinson <airbaggins@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "DepthReduction.h"
+
+#include <utility>
+#include <Corrade/Containers/Iterable.h>
+#include <Corrade/Containers/StridedArrayView.h>
+#include <Corrade/Containers/StringView.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Resource.h>
+#include <Magnum/Image.h>
+#include <Magnum/PixelFormat.h>
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/GL/Sampler.h>
+#include <Magnum/GL/Shader.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/GL/Version.h>
+
+namespace Magnum { namespace Examples {
+
+namespace {
+    enum: Int { SourceTextureUnit = 0 };
+}
+
+DepthReduction::ReductionShader::ReductionShader() {
+    MAGNUM_ASSERT_GL_VERSION_SUPPORTED(GL::Version::GL330);
+
+    const Utility::Resource rs{"shadow-data"};
+
+    GL::Shader vert{GL::Version::GL330, GL::Shader::Type::Vertex};
+    GL::Shader frag{GL::Version::GL330, GL::Shader::Type::Fragment};
+
+    vert.addSource(rs.getString("DepthReduction.vert"));
+    frag.addSource(rs.getString("DepthReduction.frag"));
+
+    CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile() && frag.compile());
+
+    attachShaders({vert, frag});
+
+    CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+
+    _depthInputUniform = uniformLocation("depthInput");
+    setUniform(uniformLocation("sourceTexture"), SourceTextureUnit);
+}
+
+DepthReduction::ReductionShader& DepthReduction::ReductionShader::bindSourceTexture(GL::Texture2D& texture) {
+    texture.bind(SourceTextureUnit);
+    return *this;
+}
+
+DepthReduction::ReductionShader& DepthReduction::ReductionShader::setDepthInput(const bool depthInput) {
+    setUniform(_depthInputUniform, Int(depthInput));
+    return *this;
+}
+
+DepthReduction::DepthReduction(const Vector2i& size): _framebuffer{{{}, size}} {
+    _depthTexture.setStorage(1, GL::TextureFormat::DepthComponent32F, size)
+        .setMinificationFilter(GL::SamplerFilter::Nearest)
+        .setMagnificationFilter(GL::SamplerFilter::Nearest);
+    _framebuffer.attachTexture(GL::Framebuffer::BufferAttachment::Depth, _depthTexture, 0)
+        .mapForDraw(GL::Framebuffer::DrawAttachment::None);
+    CORRADE_INTERNAL_ASSERT(_framebuffer.checkStatus(GL::FramebufferTarget::Draw) == GL::Framebuffer::Status::Complete);
+
+    /* Halve the size until there's a single pixel left, rounding up so the
+       odd edges aren't lost */
+    Vector2i levelSize = size;
+    do {
+        levelSize = (levelSize + Vector2i{1})/2;
+
+        Level level{GL::Texture2D{}, GL::Framebuffer{{{}, levelSize}}};
+        level.texture.setStorage(1, GL::TextureFormat::RG32F, levelSize)
+            .setMinificationFilter(GL::SamplerFilter::Nearest)
+            .setMagnificationFilter(GL::SamplerFilter::Nearest);
+        level.framebuffer.attachTexture(GL::Framebuffer::ColorAttachment{0}, level.texture, 0);
+        CORRADE_INTERNAL_ASSERT(level.framebuffer.checkStatus(GL::FramebufferTarget::Draw) == GL::Framebuffer::Status::Complete);
+        _levels.push_back(std::move(level));
+    } while(levelSize != Vector2i{1});
+
+    /* A single triangle covering the whole viewport, positions are generated
+       in the vertex shader */
+    _triangle.setCount(3);
+}
+
+Containers::Optional<Range1D> DepthReduction::reduce() {
+    GL::Renderer::disable(GL::Renderer::Feature::DepthTest);
+
+    GL::Texture2D* source = &_depthTexture;
+    _shader.setDepthInput(true);
+    for(Level& level: _levels) {
+        level.framebuffer.bind();
+        _shader.bindSourceTexture(*source)
+            .draw(_triangle);
+        _shader.setDepthInput(false);
+        source = &level.texture;
+    }
+
+    GL::Renderer::enable(GL::Renderer::Feature::DepthTest);
+
+    const Image2D image = _levels.back().framebuffer.read({{}, Vector2i{1}}, {PixelFormat::RG32F});
+    const Vector2 bounds = image.pixels<Vector2>()[0][0];
+    if(bounds.x() > bounds.y()) return {};
+    return Range1D{bounds.x(), bounds.y()};
+}
+
+}}
@@ -0,0 +1,57 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2016 — Bill Robinson <airbaggins@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+uniform highp sampler2D sourceTexture;
+
+/* Whether the source is the depth texture or a previous reduction level with
+   minimal and maximal depth in RG */
+uniform bool depthInput;
+
+out highp vec2 bounds;
+
+void main() {
+    /* Each pixel covers a 2x2 block of the source, clamped to the edge if the
+       source size is odd */
+    ivec2 sourceSize = textureSize(sourceTexture, 0);
+    ivec2 position = ivec2(gl_FragCoord.xy)*2;
+
+    /* Empty range if nothing got rendered */
+    bounds = vec2(1.0, 0.0);
+    for(int y = 0; y != 2; ++y) for(int x = 0; x != 2; ++x) {
+        highp vec2 value = texelFetch(sourceTexture, min(position + ivec2(x, y), sourceSize - ivec2(1)), 0).rg;
+
+        /* Skip pixels with the depth buffer clear value */
+        if(depthInput)
+            value = value.r < 1.0 ? value.rr : vec2(1.0, 0.0);
+
+        bounds = vec2(min(bounds.x, value.x), max(bounds.y, value.y));
+    }
+}
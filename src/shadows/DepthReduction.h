@@ -0,0 +1,98 @@
+#ifndef Magnum_Examples_Shadows_DepthReduction_h
+#define Magnum_Examples_Shadows_DepthReduction_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+        2016 — Bill Robinson <airbaggins@gmail.com>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <vector>
+#include <Corrade/Containers/Optional.h>
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Framebuffer.h>
+#include <Magnum/GL/Mesh.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/Math/Range.h>
+
+namespace Magnum { namespace Examples {
+
+/**
+@brief Calculates the range of depth buffer contents
+
+Render a depth prepass into @ref framebuffer() and then call @ref reduce().
+The depth texture is repeatedly reduced to a half-size texture of minimal and
+maximal depth on the GPU, only the final single pixel is read back.
+*/
+class DepthReduction {
+    public:
+        explicit DepthReduction(const Vector2i& size);
+
+        /** @brief Depth-only framebuffer to render the prepass into */
+        GL::Framebuffer& framebuffer() { return _framebuffer; }
+
+        /**
+         * @brief Reduce the depth buffer
+         *
+         * Returns minimal and maximal depth in the @f$ [0, 1] @f$ range,
+         * ignoring pixels with depth equal to @cpp 1.0f @ce, i.e. the ones
+         * nothing was rendered to. If nothing was rendered at all, returns
+         * @relativeref{Corrade,Containers::NullOpt}. Waits for the GPU to
+         * finish rendering.
+         */
+        Containers::Optional<Range1D> reduce();
+
+    private:
+        class ReductionShader: public GL::AbstractShaderProgram {
+            public:
+                explicit ReductionShader();
+
+                ReductionShader& bindSourceTexture(GL::Texture2D& texture);
+
+                /* Whether the source is the depth texture or a previous
+                   reduction level */
+                ReductionShader& setDepthInput(bool depthInput);
+
+            private:
+                Int _depthInputUniform;
+        };
+
+        struct Level {
+            GL::Texture2D texture;
+            GL::Framebuffer framebuffer;
+        };
+
+        GL::Texture2D _depthTexture;
+        GL::Framebuffer _framebuffer;
+        std::vector<Level> _levels;
+        ReductionShader _shader;
+        GL::Mesh _triangle;
+};
+
+}}
+
+#endif
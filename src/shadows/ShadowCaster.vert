@@ -29,10 +29,17 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-uniform highp mat4 transformationMatrix;
-
 in highp vec4 position;
 
+/* Per instance. Transformation into world space and bits of cascade layers
+   the instance is visible in. */
+in highp mat4 transformationMatrix;
+in highp uint layerMask;
+
+flat out highp uint instanceLayerMask;
+
 void main() {
+    /* Projection for each layer is applied in the geometry shader */
     gl_Position = transformationMatrix * position;
+    instanceLayerMask = layerMask;
 }
@@ -32,35 +32,56 @@
 */
 
 #include <Magnum/GL/Mesh.h>
+#include <Magnum/Math/Vector3.h>
 #include <Magnum/SceneGraph/Drawable.h>
 #include <Magnum/SceneGraph/Object.h>
 
 namespace Magnum { namespace Examples {
 
-class ShadowCasterShader;
+/**
+@brief Shadow caster
 
+Only describes what to draw, the casters are batched by mesh and drawn by
+@ref ShadowLight::render().
+*/
 class ShadowCasterDrawable: public SceneGraph::Drawable3D {
     public:
         explicit ShadowCasterDrawable(SceneGraph::AbstractObject3D& parent, SceneGraph::DrawableGroup3D* drawables);
 
-        /** @brief Mesh to use for this drawable and its bounding sphere radius */
-        void setMesh(GL::Mesh& mesh, Float radius) {
+        /**
+         * @brief Mesh to use for this drawable and its bounding sphere
+         *
+         * The sphere centre is in the local space of the mesh.
+         */
+        void setMesh(GL::Mesh& mesh, const Vector3& centre, Float radius) {
             _mesh = &mesh;
+            _centre = centre;
             _radius = radius;
         }
 
-        void setShader(ShadowCasterShader& shader) {
-            _shader = &shader;
-        }
+        GL::Mesh& mesh() { return *_mesh; }
+
+        Vector3 centre() const { return _centre; }
 
         Float radius() const { return _radius; }
 
+        /**
+         * @brief Whether the caster moves
+         *
+         * Dynamic casters are drawn every frame even if static casters are
+         * cached, see @ref ShadowLight::setCaching().
+         */
+        bool isDynamic() const { return _dynamic; }
+
+        void setDynamic(bool dynamic) { _dynamic = dynamic; }
+
         void draw(const Matrix4& transformationMatrix, SceneGraph::Camera3D& shadowCamera) override;
 
     private:
         GL::Mesh* _mesh{};
-        ShadowCasterShader* _shader{};
+        Vector3 _centre;
         Float _radius;
+        bool _dynamic = false;
 };
 
 }}
@@ -34,6 +34,7 @@
 #include <Corrade/Containers/Iterable.h>
 #include <Corrade/Containers/StringView.h>
 #include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Format.h>
 #include <Corrade/Utility/Resource.h>
 #include <Magnum/GL/Context.h>
 #include <Magnum/GL/Shader.h>
@@ -42,28 +43,36 @@
 
 namespace Magnum { namespace Examples {
 
-ShadowCasterShader::ShadowCasterShader() {
+ShadowCasterShader::ShadowCasterShader(std::size_t numShadowLevels) {
     MAGNUM_ASSERT_GL_VERSION_SUPPORTED(GL::Version::GL330);
+    CORRADE_INTERNAL_ASSERT(numShadowLevels <= 32);
 
     const Utility::Resource rs{"shadow-data"};
 
     GL::Shader vert{GL::Version::GL330, GL::Shader::Type::Vertex};
+    GL::Shader geom{GL::Version::GL330, GL::Shader::Type::Geometry};
     GL::Shader frag{GL::Version::GL330, GL::Shader::Type::Fragment};
 
     vert.addSource(rs.getString("ShadowCaster.vert"));
+    geom.addSource(Utility::format("#define NUM_SHADOW_MAP_LEVELS {}\n#define MAX_VERTICES {}\n", numShadowLevels, 3*numShadowLevels))
+        .addSource(rs.getString("ShadowCaster.geom"));
     frag.addSource(rs.getString("ShadowCaster.frag"));
 
-    CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile() && frag.compile());
+    CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile() && geom.compile() && frag.compile());
 
-    attachShaders({vert, frag});
+    bindAttributeLocation(Position::Location, "position");
+    bindAttributeLocation(TransformationMatrix::Location, "transformationMatrix");
+    bindAttributeLocation(LayerMask::Location, "layerMask");
+
+    attachShaders({vert, geom, frag});
 
     CORRADE_INTERNAL_ASSERT_OUTPUT(link());
 
-    _transformationMatrixUniform = uniformLocation("transformationMatrix");
+    _layerMatricesUniform = uniformLocation("layerMatrices");
 }
 
-ShadowCasterShader& ShadowCasterShader::setTransformationMatrix(const Matrix4& matrix) {
-    setUniform(_transformationMatrixUniform, matrix);
+ShadowCasterShader& ShadowCasterShader::setLayerMatrices(const Containers::ArrayView<const Matrix4> matrices) {
+    setUniform(_layerMatricesUniform, matrices);
     return *this;
 }
 
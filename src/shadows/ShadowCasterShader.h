@@ -31,25 +31,47 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <Corrade/Containers/ArrayView.h>
 #include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/Shaders/GenericGL.h>
 
 namespace Magnum { namespace Examples {
 
+/**
+@brief Shader rendering instanced shadow casters into all cascade layers at once
+
+Each instance is emitted by a geometry shader into every layer that's set in
+its layer mask, so the layer count is limited to 32.
+*/
 class ShadowCasterShader: public GL::AbstractShaderProgram {
     public:
-        explicit ShadowCasterShader();
+        typedef Shaders::GenericGL3D::Position Position;
+
+        /** @brief Per-instance local model space -> world space matrix */
+        typedef Shaders::GenericGL3D::TransformationMatrix TransformationMatrix;
+
+        /**
+         * @brief Per-instance mask of layers the instance is drawn into
+         *
+         * Uses the location of the generic texture offset, which the caster
+         * meshes don't have.
+         */
+        typedef GL::Attribute<15, UnsignedInt> LayerMask;
+
+        explicit ShadowCasterShader(NoCreateT): GL::AbstractShaderProgram{NoCreate} {}
+
+        explicit ShadowCasterShader(std::size_t numShadowLevels);
 
         /**
-         * @brief Set transformation matrix
+         * @brief Set layer matrices
          *
-         * Matrix that transforms from local model space -> world space ->
-         * camera space -> clip coordinates (aka model-view-projection
-         * matrix).
+         * Matrices that transform from world space -> camera space -> clip
+         * coordinates for each layer.
          */
-        ShadowCasterShader& setTransformationMatrix(const Matrix4& matrix);
+        ShadowCasterShader& setLayerMatrices(Containers::ArrayView<const Matrix4> matrices);
 
     private:
-        Int _transformationMatrixUniform;
+        Int _layerMatricesUniform;
 };
 
 }}
@@ -33,8 +33,10 @@
 
 #include <algorithm>
 #include <limits>
+#include <Corrade/Containers/ArrayViewStl.h>
 #include <Magnum/ImageView.h>
 #include <Magnum/GL/DefaultFramebuffer.h>
+#include <Magnum/GL/Mesh.h>
 #include <Magnum/GL/PixelFormat.h>
 #include <Magnum/GL/Renderer.h>
 #include <Magnum/GL/TextureFormat.h>
@@ -45,34 +47,93 @@
 
 #include "ShadowCasterDrawable.h"
 
-namespace Magnum { namespace Examples {
+namespace {
 
-ShadowLight::ShadowLight(SceneGraph::Object<SceneGraph::MatrixTransformation3D>& parent): SceneGraph::Camera3D{parent}, _object(parent), _shadowTexture{NoCreate} {
-    setAspectRatioPolicy(SceneGraph::AspectRatioPolicy::NotPreserved);
+/* Linear distance from the camera for a window-space depth */
+Float linearDepth(const Float zNear, const Float zFar, const Float depth) {
+    const Float depthSample = 2.0f*depth - 1.0f;
+    return 2.0f*zNear*zFar/(zFar + zNear - depthSample*(zFar - zNear));
 }
 
-void ShadowLight::setupShadowmaps(Int numShadowLevels, const Vector2i& size) {
-    _layers.clear();
-
-    (_shadowTexture = GL::Texture2DArray{})
-        .setImage(0, GL::TextureFormat::DepthComponent, ImageView3D{GL::PixelFormat::DepthComponent, GL::PixelType::Float, {size, numShadowLevels}})
+GL::Texture2DArray depthTexture(const Vector3i& size) {
+    GL::Texture2DArray texture;
+    texture.setImage(0, GL::TextureFormat::DepthComponent, ImageView3D{GL::PixelFormat::DepthComponent, GL::PixelType::Float, size})
         .setMaxLevel(0)
         .setCompareFunction(GL::SamplerCompareFunction::LessOrEqual)
         .setCompareMode(GL::SamplerCompareMode::CompareRefToTexture)
         .setMinificationFilter(GL::SamplerFilter::Linear, GL::SamplerMipmap::Base)
         .setMagnificationFilter(GL::SamplerFilter::Linear);
+    return texture;
+}
+
+GL::Framebuffer depthFramebuffer(const Vector2i& size, GL::Texture2DArray& texture, const Int layer) {
+    GL::Framebuffer framebuffer{{{}, size}};
+    if(layer == -1)
+        framebuffer.attachLayeredTexture(GL::Framebuffer::BufferAttachment::Depth, texture, 0);
+    else
+        framebuffer.attachTextureLayer(GL::Framebuffer::BufferAttachment::Depth, texture, 0, layer);
+    framebuffer.mapForDraw(GL::Framebuffer::DrawAttachment::None)
+        .bind();
+    CORRADE_INTERNAL_ASSERT(framebuffer.checkStatus(GL::FramebufferTarget::Draw) == GL::Framebuffer::Status::Complete);
+    return framebuffer;
+}
+
+}
+
+ShadowLight::ShadowLight(SceneGraph::Object<SceneGraph::MatrixTransformation3D>& parent): SceneGraph::Camera3D{parent}, _object(parent), _shadowTexture{NoCreate}, _shadowFramebuffer{NoCreate}, _casterShader{NoCreate}, _staticShadowTexture{NoCreate}, _staticShadowFramebuffer{NoCreate} {
+    setAspectRatioPolicy(SceneGraph::AspectRatioPolicy::NotPreserved);
+}
+
+void ShadowLight::setupShadowmaps(Int numShadowLevels, const Vector2i& size) {
+    _layers.clear();
+    _size = size;
 
-    for(std::int_fast32_t i = 0; i < numShadowLevels; ++i) {
-        _layers.emplace_back(size);
-        GL::Framebuffer& shadowFramebuffer = _layers.back().shadowFramebuffer;
-        shadowFramebuffer.attachTextureLayer(GL::Framebuffer::BufferAttachment::Depth, _shadowTexture, 0, i)
-            .mapForDraw(GL::Framebuffer::DrawAttachment::None)
-            .bind();
-        CORRADE_INTERNAL_ASSERT(shadowFramebuffer.checkStatus(GL::FramebufferTarget::Draw) == GL::Framebuffer::Status::Complete);
+    _shadowTexture = depthTexture({size, numShadowLevels});
+
+    _layers.resize(numShadowLevels);
+    _layerMatrices.resize(numShadowLevels);
+
+    /* All layers of the texture attached, the geometry shader picks the
+       layer */
+    _shadowFramebuffer = depthFramebuffer(size, _shadowTexture, -1);
+
+    _casterShader = ShadowCasterShader{std::size_t(numShadowLevels)};
+
+    if(_caching) setupStaticShadowmaps();
+}
+
+void ShadowLight::setupStaticShadowmaps() {
+    _staticShadowTexture = depthTexture({_size, Int(_layers.size())});
+    _staticShadowFramebuffer = depthFramebuffer(_size, _staticShadowTexture, -1);
+
+    _staticLayerFramebuffers.clear();
+    _layerFramebuffers.clear();
+    for(std::size_t i = 0; i != _layers.size(); ++i) {
+        _staticLayerFramebuffers.push_back(depthFramebuffer(_size, _staticShadowTexture, Int(i)));
+        _layerFramebuffers.push_back(depthFramebuffer(_size, _shadowTexture, Int(i)));
     }
+
+    invalidateStaticCasters();
 }
 
-ShadowLight::ShadowLayerData::ShadowLayerData(const Vector2i& size): shadowFramebuffer{{{}, size}} {}
+void ShadowLight::setCaching(const bool caching) {
+    if(caching == _caching) return;
+
+    _caching = caching;
+    if(caching && !_layers.empty()) {
+        setupStaticShadowmaps();
+    } else if(!caching) {
+        _staticShadowTexture = GL::Texture2DArray{NoCreate};
+        _staticShadowFramebuffer = GL::Framebuffer{NoCreate};
+        _staticLayerFramebuffers.clear();
+        _layerFramebuffers.clear();
+    }
+}
+
+void ShadowLight::invalidateStaticCasters() {
+    for(ShadowLayerData& layer: _layers)
+        layer.staticDirty = true;
+}
 
 void ShadowLight::setTarget(const Vector3& lightDirection, const Vector3& screenDirection, SceneGraph::Camera3D& mainCamera) {
     Matrix4 cameraMatrix = Matrix4::lookAt({}, -lightDirection, screenDirection);
@@ -85,10 +146,29 @@ void ShadowLight::setTarget(const Vector3& lightDirection, const Vector3& screen
 
         /* Calculate the AABB in shadow-camera space */
         Vector3 min{std::numeric_limits<Float>::max()}, max{std::numeric_limits<Float>::lowest()};
-        for(Vector3 worldPoint: mainCameraFrustumCorners) {
-            Vector3 cameraPoint = inverseCameraRotationMatrix*worldPoint;
-            min = Math::min(min, cameraPoint);
-            max = Math::max(max, cameraPoint);
+        for(Vector3& point: mainCameraFrustumCorners) {
+            point = inverseCameraRotationMatrix*point;
+            min = Math::min(min, point);
+            max = Math::max(max, point);
+        }
+
+        /* For caching, use a box around the bounding sphere instead, which
+           doesn't change with the camera orientation. Round its size and
+           snap its centre to whole texels, so it moves only when the camera
+           moves by at least a texel and cached depth stays valid otherwise. */
+        if(_caching) {
+            const Vector3 centre = (min + max)*0.5f;
+            Float radius = 0.0f;
+            for(const Vector3& point: mainCameraFrustumCorners)
+                radius = Math::max(radius, (point - centre).length());
+            radius = Math::ceil(radius*16.0f)/16.0f;
+
+            const Vector2 texelSize = Vector2{2.0f*radius}/Vector2{_size};
+            const Vector3 snappedCentre{
+                Math::floor(centre.xy()/texelSize)*texelSize,
+                Math::floor(centre.z()/texelSize.x())*texelSize.x()};
+            min = snappedCentre - Vector3{radius};
+            max = snappedCentre + Vector3{radius};
         }
 
         /* Place the shadow camera at the mid-point of the camera box */
@@ -111,24 +191,33 @@ Float ShadowLight::cutZ(const Int layer) const {
 }
 
 void ShadowLight::setupSplitDistances(const Float zNear, const Float zFar, const Float power) {
+    setupSplitDistances(zNear, zFar, power, {0.0f, 1.0f});
+}
+
+void ShadowLight::setupSplitDistances(const Float zNear, const Float zFar, const Float power, const Range1D& depthRange) {
+    /* Linear distances of the range, with some minimal thickness so the
+       layers aren't degenerate if the visible geometry is flat */
+    const Float rangeNear = linearDepth(zNear, zFar, depthRange.min());
+    const Float rangeFar = Math::max(linearDepth(zNear, zFar, depthRange.max()), rangeNear*1.01f);
+    _firstCutPlane = depthRange.min();
+
     /* props https://stackoverflow.com/a/33465663 */
     for(std::size_t i = 0; i != _layers.size(); ++i) {
-        const Float linearDepth = zNear + std::pow(Float(i + 1)/_layers.size(), power)*(zFar - zNear);
+        const Float linearDepth = rangeNear + std::pow(Float(i + 1)/_layers.size(), power)*(rangeFar - rangeNear);
         const Float nonLinearDepth = (zFar + zNear - 2.0f*zNear*zFar/linearDepth)/(zFar - zNear);
         _layers[i].cutPlane = (nonLinearDepth + 1.0f)/2.0f;
     }
 }
 
 Float ShadowLight::cutDistance(const Float zNear, const Float zFar, const Int layer) const {
-    const Float depthSample = 2.0f*_layers[layer].cutPlane - 1.0f;
-    const Float zLinear = 2.0f*zNear*zFar/(zFar + zNear - depthSample*(zFar - zNear));
-    return zLinear;
+    return linearDepth(zNear, zFar, _layers[layer].cutPlane);
 }
 
 std::vector<Vector3> ShadowLight::layerFrustumCorners(SceneGraph::Camera3D& mainCamera, const Int layer) {
-    const Float z0 = layer == 0 ? 0 : _layers[layer - 1].cutPlane;
+    /* Cut planes are window-space depths, convert to NDC */
+    const Float z0 = layer == 0 ? _firstCutPlane : _layers[layer - 1].cutPlane;
     const Float z1 = _layers[layer].cutPlane;
-    return cameraFrustumCorners(mainCamera, z0, z1);
+    return cameraFrustumCorners(mainCamera, 2.0f*z0 - 1.0f, 2.0f*z1 - 1.0f);
 }
 
 std::vector<Vector3> ShadowLight::cameraFrustumCorners(SceneGraph::Camera3D& mainCamera, const Float z0, const Float z1) {
@@ -147,27 +236,46 @@ std::vector<Vector3> ShadowLight::frustumCorners(const Matrix4& imvp, const Floa
             imvp.transformPoint({ 1, 1, z1})};
 }
 
-std::vector<Vector4> ShadowLight::calculateClipPlanes() {
+Containers::StaticArray<6, Vector4> ShadowLight::calculateClipPlanes() {
     const Matrix4 pm = projectionMatrix();
-    std::vector<Vector4> clipPlanes{
-        {pm[3][0] + pm[2][0], pm[3][1] + pm[2][1], pm[3][2] + pm[2][2], pm[3][3] + pm[2][3]},   /* near */
-        {pm[3][0] - pm[2][0], pm[3][1] - pm[2][1], pm[3][2] - pm[2][2], pm[3][3] - pm[2][3]},   /* far */
-        {pm[3][0] + pm[0][0], pm[3][1] + pm[0][1], pm[3][2] + pm[0][2], pm[3][3] + pm[0][3]},   /* left */
-        {pm[3][0] - pm[0][0], pm[3][1] - pm[0][1], pm[3][2] - pm[0][2], pm[3][3] - pm[0][3]},   /* right */
-        {pm[3][0] + pm[1][0], pm[3][1] + pm[1][1], pm[3][2] + pm[1][2], pm[3][3] + pm[1][3]},   /* bottom */
-        {pm[3][0] - pm[1][0], pm[3][1] - pm[1][1], pm[3][2] - pm[1][2], pm[3][3] - pm[1][3]}};  /* top */
+    Containers::StaticArray<6, Vector4> clipPlanes{InPlaceInit,
+        Vector4{pm[3][0] + pm[2][0], pm[3][1] + pm[2][1], pm[3][2] + pm[2][2], pm[3][3] + pm[2][3]},   /* near */
+        Vector4{pm[3][0] - pm[2][0], pm[3][1] - pm[2][1], pm[3][2] - pm[2][2], pm[3][3] - pm[2][3]},   /* far */
+        Vector4{pm[3][0] + pm[0][0], pm[3][1] + pm[0][1], pm[3][2] + pm[0][2], pm[3][3] + pm[0][3]},   /* left */
+        Vector4{pm[3][0] - pm[0][0], pm[3][1] - pm[0][1], pm[3][2] - pm[0][2], pm[3][3] - pm[0][3]},   /* right */
+        Vector4{pm[3][0] + pm[1][0], pm[3][1] + pm[1][1], pm[3][2] + pm[1][2], pm[3][3] + pm[1][3]},   /* bottom */
+        Vector4{pm[3][0] - pm[1][0], pm[3][1] - pm[1][1], pm[3][2] - pm[1][2], pm[3][3] - pm[1][3]}};  /* top */
     for(Vector4& plane: clipPlanes)
         plane *= plane.xyz().lengthInverted();
     return clipPlanes;
 }
 
 void ShadowLight::render(SceneGraph::DrawableGroup3D& drawables) {
-    /* Compute transformations of all objects in the group relative to the camera */
-    std::vector<std::reference_wrapper<Object3D>> objects;
-    objects.reserve(drawables.size());
+    /* Compute world transformations of all objects in the group just once,
+       each layer then only applies its own camera matrix to them. Filled in
+       place, as SceneGraph::Scene::transformationMatrices() would allocate a
+       new vector every frame. */
+    _worldTransformations.resize(drawables.size());
     for(std::size_t i = 0; i != drawables.size(); ++i)
-        objects.push_back(static_cast<Object3D&>(drawables[i].object()));
-    std::vector<ShadowCasterDrawable*> filteredDrawables;
+        _worldTransformations[i] = drawables[i].object().absoluteTransformationMatrix();
+    _layerMasks.assign(drawables.size(), 0);
+    _staticLayerMasks.assign(drawables.size(), 0);
+
+    /* Calculate world-space bounding spheres of the casters, rebuild the
+       hierarchy if casters were added or removed and refit it if some of
+       them moved */
+    _previousCasterSpheres.swap(_casterSpheres);
+    _casterSpheres.resize(drawables.size());
+    for(std::size_t i = 0; i != drawables.size(); ++i) {
+        auto& drawable = static_cast<ShadowCasterDrawable&>(drawables[i]);
+        const Matrix4& transformation = _worldTransformations[i];
+        _casterSpheres[i] = {transformation.transformPoint(drawable.centre()),
+            drawable.radius()*std::sqrt(transformation.scalingSquared().max())};
+    }
+    if(_casterSpheres.size() != _previousCasterSpheres.size())
+        _casterHierarchy.build(_casterSpheres);
+    else if(_casterSpheres != _previousCasterSpheres)
+        _casterHierarchy.refit(_casterSpheres);
 
     /* Projecting world points normalized device coordinates means they range
        -1 -> 1. Use this bias matrix so we go straight from world -> texture
@@ -179,9 +287,17 @@ void ShadowLight::render(SceneGraph::DrawableGroup3D& drawables) {
 
     GL::Renderer::setDepthMask(true);
 
+    UnsignedInt staticDirtyLayers = 0;
     for(std::size_t layer = 0; layer != _layers.size(); ++layer) {
         ShadowLayerData& d = _layers[layer];
-        Float orthographicNear = d.orthographicNear;
+
+        /* With caching, static casters are drawn only if the layer moved
+           since their depth was cached. Otherwise the cached near plane has
+           to be kept and only dynamic casters are considered. */
+        const bool dirty = !_caching || d.staticDirty ||
+            d.shadowCameraMatrix != d.cachedCameraMatrix ||
+            d.orthographicSize != d.cachedOrthographicSize;
+        Float orthographicNear = dirty ? d.orthographicNear : d.cachedOrthographicNear;
         const Float orthographicFar = d.orthographicFar;
 
         /* Move this whole object to the right place to render each layer */
@@ -189,59 +305,116 @@ void ShadowLight::render(SceneGraph::DrawableGroup3D& drawables) {
             .setClean();
         setProjectionMatrix(Matrix4::orthographicProjection(d.orthographicSize, orthographicNear, orthographicFar));
 
-        const std::vector<Vector4> clipPlanes = calculateClipPlanes();
-        std::vector<Matrix4> transformations = _object.scene()->transformationMatrices(objects, cameraMatrix());
-
-        /* Rebuild the list of objects we will draw by clipping them with the
-           shadow camera's planes */
-        std::size_t transformationsOutIndex = 0;
-        filteredDrawables.clear();
-        for(std::size_t drawableIndex = 0; drawableIndex != drawables.size(); ++drawableIndex) {
+        const Containers::StaticArray<6, Vector4> clipPlanes = calculateClipPlanes();
+        const Matrix4 shadowCameraMatrix = cameraMatrix();
+
+        /* Transform the shadow camera's planes to world space so they can be
+           tested against the hierarchy directly. Start at 1, not 0 to skip
+           out the near plane because we need to include shadow casters
+           traveling the direction the camera is facing. */
+        const Matrix4 planeTransformation = shadowCameraMatrix.transposed();
+        Vector4 worldClipPlanes[5];
+        for(std::size_t i = 0; i != Containers::arraySize(worldClipPlanes); ++i)
+            worldClipPlanes[i] = planeTransformation*clipPlanes[i + 1];
+
+        /* Mark objects we will draw into this layer */
+        _visibleCasters.clear();
+        d.culledCasters = _casterHierarchy.cull(worldClipPlanes, _casterSpheres, _visibleCasters);
+        d.drawnCasters = 0;
+        for(const UnsignedInt drawableIndex: _visibleCasters) {
             auto& drawable = static_cast<ShadowCasterDrawable&>(drawables[drawableIndex]);
-            const Matrix4 transform = transformations[drawableIndex];
-
-            /* If your centre is offset, inject it here */
-            const Vector4 localCentre{0.0f, 0.0f, 0.0f, 1.0f};
-            const Vector4 drawableCentre = transform*localCentre;
-
-            /* Start at 1, not 0 to skip out the near plane because we need to
-               include shadow casters traveling the direction the camera is
-               facing. */
-            for(std::size_t clipPlaneIndex = 1; clipPlaneIndex != clipPlanes.size(); ++clipPlaneIndex) {
-                const Float distance = Math::dot(clipPlanes[clipPlaneIndex], drawableCentre);
-
-                /* If the object is on the useless side of any one plane, we can skip it */
-                if(distance < -drawable.radius())
-                    goto next;
-            }
-
-            {
-                /* If this object extends in front of the near plane, extend
-                   the near plane. We negate the z because the negative z is
-                   forward away from the camera, but the near/far planes are
-                   measured forwards. */
-                const Float nearestPoint = -drawableCentre.z() - drawable.radius();
+            const bool isStatic = _caching && !drawable.isDynamic();
+            if(isStatic && !dirty) continue;
+
+            /* If this object extends in front of the near plane, extend the
+               near plane. We negate the z because the negative z is forward
+               away from the camera, but the near/far planes are measured
+               forwards. */
+            if(dirty) {
+                const Vector4& sphere = _casterSpheres[drawableIndex];
+                const Float nearestPoint = -shadowCameraMatrix.transformPoint(sphere.xyz()).z() - sphere.w();
                 orthographicNear = Math::min(orthographicNear, nearestPoint);
-                filteredDrawables.push_back(&drawable);
-                transformations[transformationsOutIndex++] = transform;
             }
-
-            next:;
+            (isStatic ? _staticLayerMasks : _layerMasks)[drawableIndex] |= 1u << layer;
+            ++d.drawnCasters;
         }
 
         /* Recalculate the projection matrix with new near plane. */
         const Matrix4 shadowCameraProjectionMatrix =
             Matrix4::orthographicProjection(d.orthographicSize, orthographicNear, orthographicFar);
-        d.shadowMatrix = bias*shadowCameraProjectionMatrix*cameraMatrix();
+        _layerMatrices[layer] = shadowCameraProjectionMatrix*shadowCameraMatrix;
+        d.shadowMatrix = bias*_layerMatrices[layer];
         setProjectionMatrix(shadowCameraProjectionMatrix);
 
-        d.shadowFramebuffer.clear(GL::FramebufferClear::Depth)
-            .bind();
-        for(std::size_t i = 0; i != transformationsOutIndex; ++i)
-            filteredDrawables[i]->draw(transformations[i], *this);
+        if(_caching && dirty) {
+            d.cachedCameraMatrix = d.shadowCameraMatrix;
+            d.cachedOrthographicSize = d.orthographicSize;
+            d.cachedOrthographicNear = orthographicNear;
+            d.staticDirty = false;
+            staticDirtyLayers |= 1u << layer;
+        }
+    }
+
+    if(_caching) {
+        /* Dynamic casters in front of the cached near plane would get
+           clipped, clamp them to it instead */
+        GL::Renderer::enable(GL::Renderer::Feature::DepthClamp);
+
+        /* Re-render static casters into layers that moved */
+        if(staticDirtyLayers) {
+            for(std::size_t layer = 0; layer != _layers.size(); ++layer)
+                if(staticDirtyLayers & (1u << layer))
+                    _staticLayerFramebuffers[layer].clear(GL::FramebufferClear::Depth);
+            drawCasters(drawables, _staticLayerMasks, _staticShadowFramebuffer);
+        }
+
+        /* Start from the cached depth and draw dynamic casters on top */
+        for(std::size_t layer = 0; layer != _layers.size(); ++layer)
+            GL::AbstractFramebuffer::blit(_staticLayerFramebuffers[layer], _layerFramebuffers[layer], {{}, _size}, GL::FramebufferBlit::Depth);
+        drawCasters(drawables, _layerMasks, _shadowFramebuffer);
+
+        GL::Renderer::disable(GL::Renderer::Feature::DepthClamp);
+
+    } else {
+        _shadowFramebuffer.clear(GL::FramebufferClear::Depth);
+        drawCasters(drawables, _layerMasks, _shadowFramebuffer);
     }
 
     GL::defaultFramebuffer.bind();
 }
 
+void ShadowLight::drawCasters(SceneGraph::DrawableGroup3D& drawables, const std::vector<UnsignedInt>& layerMasks, GL::Framebuffer& framebuffer) {
+    /* Group casters visible in at least one layer by their mesh */
+    for(Batch& batch: _batches)
+        batch.instances.clear();
+    for(std::size_t drawableIndex = 0; drawableIndex != drawables.size(); ++drawableIndex) {
+        if(!layerMasks[drawableIndex]) continue;
+
+        auto& drawable = static_cast<ShadowCasterDrawable&>(drawables[drawableIndex]);
+        auto found = std::find_if(_batches.begin(), _batches.end(), [&](const Batch& batch) {
+            return batch.mesh == &drawable.mesh();
+        });
+        if(found == _batches.end()) {
+            _batches.push_back(Batch{&drawable.mesh(), GL::Buffer{}, {}});
+            found = _batches.end() - 1;
+            found->mesh->addVertexBufferInstanced(found->instanceBuffer, 1, 0,
+                ShadowCasterShader::TransformationMatrix{},
+                ShadowCasterShader::LayerMask{});
+        }
+
+        found->instances.push_back({_worldTransformations[drawableIndex], layerMasks[drawableIndex]});
+    }
+
+    /* Draw each mesh once into all layers */
+    framebuffer.bind();
+    _casterShader.setLayerMatrices(_layerMatrices);
+    for(Batch& batch: _batches) {
+        if(batch.instances.empty()) continue;
+
+        batch.instanceBuffer.setData(batch.instances, GL::BufferUsage::StreamDraw);
+        batch.mesh->setInstanceCount(batch.instances.size());
+        _casterShader.draw(*batch.mesh);
+    }
+}
+
 }}
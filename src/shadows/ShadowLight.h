@@ -31,17 +31,25 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <vector>
+#include <Corrade/Containers/StaticArray.h>
 #include <Magnum/Resource.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/GL/Buffer.h>
 #include <Magnum/GL/Framebuffer.h>
 #include <Magnum/GL/TextureArray.h>
 #include <Magnum/SceneGraph/Camera.h>
 #include <Magnum/SceneGraph/Drawable.h>
 #include <Magnum/SceneGraph/AbstractFeature.h>
 
+#include "BoundingSphereHierarchy.h"
+#include "ShadowCasterShader.h"
 #include "Types.h"
 
 namespace Magnum { namespace Examples {
 
+class ShadowCasterDrawable;
+
 /**
 @brief A special camera used to render shadow maps
 
@@ -56,7 +64,7 @@ class ShadowLight: public SceneGraph::Camera3D {
         explicit ShadowLight(SceneGraph::Object<SceneGraph::MatrixTransformation3D>& parent);
 
         /**
-         * @brief Initialize the shadow map texture array and framebuffers
+         * @brief Initialize the shadow map texture array, framebuffer and shader
          *
          * Should be called before @ref setupSplitDistances().
          */
@@ -70,6 +78,17 @@ class ShadowLight: public SceneGraph::Camera3D {
          */
         void setupSplitDistances(Float cameraNear, Float cameraFar, Float power);
 
+        /**
+         * @brief Fit the distances we should cut the view frustum along to a depth range
+         *
+         * Like @ref setupSplitDistances(Float, Float, Float), but the
+         * distances are distributed only between given window-space depths
+         * of the main camera, usually the range of what's visible calculated
+         * from the depth buffer. The layers then cover only the visible
+         * geometry and can have a much higher effective resolution.
+         */
+        void setupSplitDistances(Float cameraNear, Float cameraFar, Float power, const Range1D& depthRange);
+
         /**
          * @brief Computes all the matrices for the shadow map splits
          * @param lightDirection    Direction of travel of the light
@@ -85,13 +104,46 @@ class ShadowLight: public SceneGraph::Camera3D {
          */
         void setTarget(const Vector3& lightDirection, const Vector3& screenDirection, SceneGraph::Camera3D& mainCamera);
 
+        /** @brief Whether depth of static shadow casters is cached */
+        bool isCaching() const { return _caching; }
+
+        /**
+         * @brief Enable or disable caching of static shadow casters
+         *
+         * When enabled, depth of casters that aren't marked as dynamic is
+         * kept in a separate texture array and re-rendered for a layer only
+         * if the layer moved in light space or after
+         * @ref invalidateStaticCasters(). Layer bounds are then calculated
+         * from a bounding sphere of the frustum split and snapped to whole
+         * texels, so they move only when the camera moves by at least a
+         * texel. Dynamic casters are drawn on top of the cached depth in
+         * every @ref render().
+         */
+        void setCaching(bool caching);
+
+        /**
+         * @brief Re-render static casters in the next @ref render()
+         *
+         * Call when a static caster moves or the face culling mode changes.
+         */
+        void invalidateStaticCasters();
+
         /**
          * @brief Render a group of shadow-casting drawables to the shadow maps
+         *
+         * Casters sharing a mesh are drawn with a single instanced draw call
+         * into all layers they're visible in. Instance buffers are attached
+         * to the meshes on first use, so the meshes shouldn't be used for
+         * anything else.
          */
         void render(SceneGraph::DrawableGroup3D& drawables);
 
         std::vector<Vector3> layerFrustumCorners(SceneGraph::Camera3D& mainCamera, Int layer);
 
+        /* Window-space depth at which the first layer starts */
+        Float firstCutZ() const { return _firstCutPlane; }
+
+        /* Window-space depth at which given layer ends */
         Float cutZ(Int layer) const;
 
         Float cutDistance(Float zNear, Float zFar, Int layer) const;
@@ -102,26 +154,95 @@ class ShadowLight: public SceneGraph::Camera3D {
             return _layers[layer].shadowMatrix;
         }
 
-        std::vector<Vector4> calculateClipPlanes();
+        /** @brief Count of casters drawn into a layer in the last render() */
+        UnsignedInt drawnCasters(Int layer) const {
+            return _layers[layer].drawnCasters;
+        }
+
+        /**
+         * @brief Count of casters culled for a layer in the last render()
+         *
+         * Cached static casters inside the layer are counted in neither this
+         * nor @ref drawnCasters().
+         */
+        UnsignedInt culledCasters(Int layer) const {
+            return _layers[layer].culledCasters;
+        }
+
+        /* Near, far, left, right, bottom, top */
+        Containers::StaticArray<6, Vector4> calculateClipPlanes();
 
         GL::Texture2DArray& shadowTexture() { return _shadowTexture; }
 
     private:
+        /* Set up the static texture and framebuffers for caching */
+        void setupStaticShadowmaps();
+
+        /* Draw casters with a non-zero layer mask into given layered
+           framebuffer, one instanced draw per mesh */
+        void drawCasters(SceneGraph::DrawableGroup3D& drawables, const std::vector<UnsignedInt>& layerMasks, GL::Framebuffer& framebuffer);
+
         Object3D& _object;
+        Vector2i _size;
         GL::Texture2DArray _shadowTexture;
+        /* All layers of the texture attached, the geometry shader picks the
+           layer */
+        GL::Framebuffer _shadowFramebuffer;
+        ShadowCasterShader _casterShader;
+
+        /* Depth of static casters and framebuffers for clearing it and
+           copying it to the shadow texture layer by layer, present only in
+           caching mode */
+        bool _caching = false;
+        GL::Texture2DArray _staticShadowTexture;
+        GL::Framebuffer _staticShadowFramebuffer;
+        std::vector<GL::Framebuffer> _staticLayerFramebuffers, _layerFramebuffers;
 
         struct ShadowLayerData {
-            GL::Framebuffer shadowFramebuffer;
             Matrix4 shadowCameraMatrix;
             Matrix4 shadowMatrix;
             Vector2 orthographicSize;
             Float orthographicNear, orthographicFar;
             Float cutPlane;
 
-            explicit ShadowLayerData(const Vector2i& size);
+            /* Layer placement the cached static depth was rendered with */
+            Matrix4 cachedCameraMatrix;
+            Vector2 cachedOrthographicSize;
+            Float cachedOrthographicNear;
+            bool staticDirty = true;
+
+            UnsignedInt drawnCasters, culledCasters;
         };
 
         std::vector<ShadowLayerData> _layers;
+        Float _firstCutPlane{};
+
+        /* Layout matches the per-instance attributes of ShadowCasterShader */
+        struct Instance {
+            Matrix4 transformationMatrix;
+            UnsignedInt layerMask;
+        };
+
+        /* Visible casters sharing the same mesh */
+        struct Batch {
+            GL::Mesh* mesh;
+            GL::Buffer instanceBuffer;
+            std::vector<Instance> instances;
+        };
+
+        std::vector<Batch> _batches;
+
+        /* World-space bounding spheres of casters from the last render() and
+           a hierarchy over them, rebuilt only if the caster count changes */
+        std::vector<Vector4> _casterSpheres, _previousCasterSpheres;
+        BoundingSphereHierarchy _casterHierarchy;
+
+        /* Scratch memory for render(), kept to avoid allocations every
+           frame */
+        std::vector<Matrix4> _worldTransformations;
+        std::vector<UnsignedInt> _layerMasks, _staticLayerMasks;
+        std::vector<UnsignedInt> _visibleCasters;
+        std::vector<Matrix4> _layerMatrices;
 };
 
 }}
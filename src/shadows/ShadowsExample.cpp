@@ -29,10 +29,14 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/Pointer.h>
 #include <Magnum/GL/Buffer.h>
 #include <Magnum/GL/DefaultFramebuffer.h>
 #include <Magnum/GL/Renderer.h>
 #include <Magnum/GL/Texture.h>
+#include <Magnum/Math/Functions.h>
 #include <Magnum/MeshTools/Compile.h>
 #include <Magnum/MeshTools/CompressIndices.h>
 #include <Magnum/Platform/Sdl2Application.h>
@@ -48,7 +52,7 @@
 #include <Magnum/Trade/MeshData.h>
 
 #include "DebugLines.h"
-#include "ShadowCasterShader.h"
+#include "DepthReduction.h"
 #include "ShadowReceiverShader.h"
 #include "ShadowLight.h"
 #include "ShadowCasterDrawable.h"
@@ -68,7 +72,13 @@ class ShadowsExample: public Platform::Application {
 
     private:
         struct Model {
+            GL::Buffer indices, vertices;
             GL::Mesh mesh;
+            /* Separate mesh for casters referencing the same buffers,
+               ShadowLight attaches instance buffers to it and changes its
+               instance count */
+            GL::Mesh casterMesh;
+            Vector3 centre;
             Float radius;
         };
 
@@ -81,7 +91,7 @@ class ShadowsExample: public Platform::Application {
 
         void addModel(const Trade::MeshData& meshData3D);
         void renderDebugLines();
-        Object3D* createSceneObject(Model& model, bool makeCaster, bool makeReceiver);
+        Object3D* createSceneObject(Model& model, bool makeCaster, bool makeReceiver, bool dynamicCaster = false);
         void recompileReceiverShader(std::size_t numLayers);
         void setShadowMapSize(const Vector2i& shadowMapSize);
         void setShadowSplitExponent(Float power);
@@ -89,7 +99,6 @@ class ShadowsExample: public Platform::Application {
         Scene3D _scene;
         SceneGraph::DrawableGroup3D _shadowCasterDrawables;
         SceneGraph::DrawableGroup3D _shadowReceiverDrawables;
-        ShadowCasterShader _shadowCasterShader;
         ShadowReceiverShader _shadowReceiverShader{NoCreate};
 
         DebugLines _debugLines;
@@ -106,6 +115,19 @@ class ShadowsExample: public Platform::Application {
 
         std::vector<Model> _models;
 
+        /* Casters bobbing up and down to show caching of the static ones */
+        struct DynamicCaster {
+            Object3D* object;
+            Vector3 position;
+        };
+        std::vector<DynamicCaster> _dynamicCasters;
+        Float _animationTime{};
+        bool _animating{};
+
+        /* Present if the layers are fitted to the depth range of what's
+           visible */
+        Containers::Pointer<DepthReduction> _depthReduction;
+
         Vector3 _mainCameraVelocity;
 
         Float _shadowBias;
@@ -145,11 +167,14 @@ ShadowsExample::ShadowsExample(const Arguments& arguments):
 
     for(std::size_t i = 0; i != 200; ++i) {
         Model& model = _models[std::rand()%_models.size()];
-        Object3D* object = createSceneObject(model, true, true);
-        object->setTransformation(Matrix4::translation({
+        const bool dynamic = i % 10 == 0;
+        Object3D* object = createSceneObject(model, true, true, dynamic);
+        const Vector3 position{
             std::rand()*100.0f/RAND_MAX - 50.0f,
             std::rand()*5.0f/RAND_MAX,
-            std::rand()*100.0f/RAND_MAX - 50.0f}));
+            std::rand()*100.0f/RAND_MAX - 50.0f};
+        object->setTransformation(Matrix4::translation(position));
+        if(dynamic) _dynamicCasters.push_back({object, position});
     }
 
     _shadowLight.setupSplitDistances(MainCameraNear, MainCameraFar, _layerSplitExponent);
@@ -172,13 +197,13 @@ ShadowsExample::ShadowsExample(const Arguments& arguments):
         {3.0f, 1.0f, 2.0f}, {}, Vector3::yAxis()));
 }
 
-Object3D* ShadowsExample::createSceneObject(Model& model, bool makeCaster, bool makeReceiver) {
+Object3D* ShadowsExample::createSceneObject(Model& model, bool makeCaster, bool makeReceiver, bool dynamicCaster) {
     auto* object = new Object3D(&_scene);
 
     if(makeCaster) {
         auto caster = new ShadowCasterDrawable(*object, &_shadowCasterDrawables);
-        caster->setShader(_shadowCasterShader);
-        caster->setMesh(model.mesh, model.radius);
+        caster->setMesh(model.casterMesh, model.centre, model.radius);
+        caster->setDynamic(dynamicCaster);
     }
 
     if(makeReceiver) {
@@ -194,9 +219,18 @@ void ShadowsExample::addModel(const Trade::MeshData& meshData) {
     _models.emplace_back();
     Model& model = _models.back();
 
+    /* Bounding sphere around the centre of the bounding box, the mesh
+       doesn't need to be centered around its origin */
+    const Containers::Array<Vector3> positions = meshData.positions3DAsArray();
+    Vector3 min = positions[0], max = positions[0];
+    for(Vector3 position: positions) {
+        min = Math::min(min, position);
+        max = Math::max(max, position);
+    }
+    model.centre = (min + max)*0.5f;
     Float maxMagnitudeSquared = 0.0f;
-    for(Vector3 position: meshData.positions3DAsArray()) {
-        Float magnitudeSquared = position.dot();
+    for(Vector3 position: positions) {
+        Float magnitudeSquared = (position - model.centre).dot();
 
         if(magnitudeSquared > maxMagnitudeSquared) {
             maxMagnitudeSquared = magnitudeSquared;
@@ -204,7 +238,11 @@ void ShadowsExample::addModel(const Trade::MeshData& meshData) {
     }
     model.radius = std::sqrt(maxMagnitudeSquared);
 
-    model.mesh = MeshTools::compile(MeshTools::compressIndices(meshData));
+    const Trade::MeshData compressed = MeshTools::compressIndices(meshData);
+    model.indices.setData(compressed.indexData());
+    model.vertices.setData(compressed.vertexData());
+    model.mesh = MeshTools::compile(compressed, model.indices, model.vertices);
+    model.casterMesh = MeshTools::compile(compressed, model.indices, model.vertices);
 }
 
 void ShadowsExample::drawEvent() {
@@ -215,6 +253,26 @@ void ShadowsExample::drawEvent() {
         redraw();
     }
 
+    if(_animating) {
+        _animationTime += 1.0f/60.0f;
+        for(const DynamicCaster& caster: _dynamicCasters)
+            caster.object->setTransformation(Matrix4::translation(caster.position + Vector3::yAxis(1.0f + Math::sin(Rad{_animationTime*2.0f + caster.position.x()}))));
+        redraw();
+    }
+
+    /* Depth prepass from the main camera, the layers are then fitted only
+       to the depth range of the visible geometry. Receivers draw just the
+       depth as the framebuffer has no color attachment. */
+    if(_depthReduction) {
+        _depthReduction->framebuffer()
+            .clear(GL::FramebufferClear::Depth)
+            .bind();
+        _mainCamera.draw(_shadowReceiverDrawables);
+        if(Containers::Optional<Range1D> depthRange = _depthReduction->reduce())
+            _shadowLight.setupSplitDistances(MainCameraNear, MainCameraFar, _layerSplitExponent, *depthRange);
+        GL::defaultFramebuffer.bind();
+    }
+
     const Vector3 screenDirection = _shadowStaticAlignment ? Vector3::zAxis() : _mainCameraObject.transformation()[2].xyz();
     /* You only really need to do this when your camera moves */
     _shadowLight.setTarget({3, 2, 3}, screenDirection, _mainCamera);
@@ -278,7 +336,8 @@ void ShadowsExample::renderDebugLines() {
             Color3::fromHsv({hue, 1.0f, 0.5f}));
         _debugLines.addFrustum(imvp,
             Color3::fromHsv({hue, 1.0f, 1.0f}),
-            layerIndex == 0 ? 0 : _shadowLight.cutZ(layerIndex - 1), _shadowLight.cutZ(layerIndex));
+            2.0f*(layerIndex == 0 ? _shadowLight.firstCutZ() : _shadowLight.cutZ(layerIndex - 1)) - 1.0f,
+            2.0f*_shadowLight.cutZ(layerIndex) - 1.0f);
     }
 
     _debugLines.draw(_activeCamera->projectionMatrix()*_activeCamera->cameraMatrix());
@@ -351,6 +410,7 @@ void ShadowsExample::keyPressEvent(KeyEvent& event) {
         _shadowMapFaceCullMode = (_shadowMapFaceCullMode + 1) % 3;
         Debug() << "Face cull mode:"
             << (_shadowMapFaceCullMode == 0 ? "no cull" : _shadowMapFaceCullMode == 1 ? "cull back" : "cull front");
+        _shadowLight.invalidateStaticCasters();
 
     } else if(event.key() == Key::F4) {
         _shadowStaticAlignment = !_shadowStaticAlignment;
@@ -389,6 +449,28 @@ void ShadowsExample::keyPressEvent(KeyEvent& event) {
             Debug() << "Shadow map size" << _shadowMapSize << "x" << _shadowLight.layerCount() << "layers";
         } else return;
 
+    } else if(event.key() == Key::C) {
+        _shadowLight.setCaching(!_shadowLight.isCaching());
+        Debug() << "Static caster caching:"
+            << (_shadowLight.isCaching() ? "on" : "off");
+
+    } else if(event.key() == Key::Space) {
+        _animating = !_animating;
+
+    } else if(event.key() == Key::D) {
+        if(_depthReduction) {
+            _depthReduction = nullptr;
+            _shadowLight.setupSplitDistances(MainCameraNear, MainCameraFar, _layerSplitExponent);
+        } else _depthReduction.emplace(GL::defaultFramebuffer.viewport().size());
+        Debug() << "Shadow splits:"
+            << (_depthReduction ? "fitted to visible depth range" : "fixed");
+
+    } else if(event.key() == Key::S) {
+        for(std::size_t layer = 0; layer != _shadowLight.layerCount(); ++layer)
+            Debug() << "Shadow layer" << layer << "casters drawn:"
+                << _shadowLight.drawnCasters(layer) << "culled:"
+                << _shadowLight.culledCasters(layer);
+
     } else if(event.key() == Key::F11) {
         setShadowMapSize(_shadowMapSize/2);
 
@@ -0,0 +1,299 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "AssetLoader.h"
+
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Containers/StridedArrayView.h>
+#include <Corrade/PluginManager/Manager.h>
+#include <Corrade/Utility/ConfigurationGroup.h>
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Math/Half.h>
+#include <Magnum/Math/PackingBatch.h>
+#include <Magnum/MeshTools/CompressIndices.h>
+#include <Magnum/MeshTools/Duplicate.h>
+#include <Magnum/MeshTools/Filter.h>
+#include <Magnum/MeshTools/GenerateNormals.h>
+#include <Magnum/MeshTools/Interleave.h>
+#include <Magnum/MeshTools/Reference.h>
+#include <Magnum/MeshTools/RemoveDuplicates.h>
+#include <Magnum/Trade/AbstractImporter.h>
+#include <Magnum/Trade/AbstractSceneConverter.h>
+
+namespace Magnum { namespace Examples {
+
+namespace {
+
+/* Half-float vertex attributes are only an extension on ES2 and WebGL 1, so
+   texture coordinates stay as floats there */
+#ifndef MAGNUM_TARGET_GLES2
+typedef Vector2h TextureCoordinate;
+#else
+typedef Vector2 TextureCoordinate;
+#endif
+
+/* Packs normals to 16-bit normalized integers and texture coordinates to
+   half-floats where supported, positions stay as floats. Only the first
+   texture coordinate set is kept. The index data are referenced from the
+   original mesh. */
+Trade::MeshData quantize(const Trade::MeshData& mesh) {
+    const bool hasTextureCoordinates = mesh.hasAttribute(Trade::MeshAttribute::TextureCoordinates);
+
+    /* Normals are padded to 8 bytes to keep the texture coordinates
+       four-byte aligned */
+    const std::size_t stride = sizeof(Vector3) + 8 +
+        (hasTextureCoordinates ? sizeof(TextureCoordinate) : 0);
+    Containers::Array<char> vertexData{NoInit, mesh.vertexCount()*stride};
+    Containers::StridedArrayView1D<Vector3> positions{vertexData,
+        reinterpret_cast<Vector3*>(vertexData.data()),
+        mesh.vertexCount(), std::ptrdiff_t(stride)};
+    Containers::StridedArrayView1D<Vector3s> normals{vertexData,
+        reinterpret_cast<Vector3s*>(vertexData.data() + sizeof(Vector3)),
+        mesh.vertexCount(), std::ptrdiff_t(stride)};
+    Containers::StridedArrayView1D<TextureCoordinate> textureCoordinates{vertexData,
+        reinterpret_cast<TextureCoordinate*>(vertexData.data() + sizeof(Vector3) + 8),
+        hasTextureCoordinates ? mesh.vertexCount() : 0, std::ptrdiff_t(stride)};
+
+    mesh.positions3DInto(positions);
+    Math::packInto(
+        Containers::arrayCast<2, const Float>(Containers::stridedArrayView(mesh.normalsAsArray())),
+        Containers::arrayCast<2, Short>(normals));
+
+    Containers::Array<Trade::MeshAttributeData> attributes{hasTextureCoordinates ? 3u : 2u};
+    attributes[0] = Trade::MeshAttributeData{Trade::MeshAttribute::Position, positions};
+    attributes[1] = Trade::MeshAttributeData{Trade::MeshAttribute::Normal,
+        VertexFormat::Vector3sNormalized, normals};
+    if(hasTextureCoordinates) {
+        #ifndef MAGNUM_TARGET_GLES2
+        Math::packHalfInto(
+            Containers::arrayCast<2, const Float>(Containers::stridedArrayView(mesh.textureCoordinates2DAsArray())),
+            Containers::arrayCast<2, UnsignedShort>(textureCoordinates));
+        #else
+        mesh.textureCoordinates2DInto(textureCoordinates);
+        #endif
+        attributes[2] = Trade::MeshAttributeData{
+            Trade::MeshAttribute::TextureCoordinates, textureCoordinates};
+    }
+
+    return Trade::MeshData{mesh.primitive(), Trade::DataFlags{}, mesh.indexData(),
+        Trade::MeshIndexData{mesh.indices()},
+        std::move(vertexData), std::move(attributes)};
+}
+
+Trade::MeshData optimize(const Trade::MeshData& mesh, Trade::AbstractSceneConverter* const optimizer) {
+    /* Drop attributes the viewer doesn't use, so vertices that differ only
+       in those can be merged below */
+    Trade::MeshData filtered = MeshTools::filterOnlyAttributes(mesh, {
+        Trade::MeshAttribute::Position,
+        Trade::MeshAttribute::Normal,
+        Trade::MeshAttribute::TextureCoordinates
+    });
+
+    /* Generate flat normals if not present, same as MeshTools::compile()
+       would do. That needs a non-indexed mesh. */
+    if(!filtered.hasAttribute(Trade::MeshAttribute::Normal)) {
+        const Trade::MeshData nonIndexed = filtered.isIndexed() ?
+            MeshTools::duplicate(filtered) : MeshTools::reference(filtered);
+        const Containers::Array<Vector3> normals =
+            MeshTools::generateFlatNormals(nonIndexed.positions3DAsArray());
+        filtered = MeshTools::interleave(nonIndexed, {
+            Trade::MeshAttributeData{Trade::MeshAttribute::Normal,
+                Containers::stridedArrayView(normals)}
+        });
+    }
+
+    /* Merge vertices that are the same, the result is always indexed */
+    Trade::MeshData deduplicated = MeshTools::removeDuplicates(filtered);
+
+    /* Reorder the triangles for the post-transform vertex cache and to
+       reduce overdraw, and the vertices for memory access locality */
+    if(optimizer) {
+        if(Containers::Optional<Trade::MeshData> optimized = optimizer->convert(deduplicated))
+            deduplicated = std::move(*optimized);
+    }
+
+    /* Use 16-bit indices if the vertex count allows, 32-bit otherwise */
+    return MeshTools::compressIndices(quantize(deduplicated));
+}
+
+}
+
+struct AssetLoader::Plugins {
+    PluginManager::Manager<Trade::AbstractImporter> importerManager;
+    PluginManager::Manager<Trade::AbstractSceneConverter> converterManager;
+    Containers::Pointer<Trade::AbstractImporter> importer;
+    Containers::Pointer<Trade::AbstractSceneConverter> meshOptimizer;
+    Containers::Pointer<Trade::AbstractSceneConverter> meshSimplifier;
+};
+
+AssetLoader::AssetLoader(const Containers::StringView importerPlugin, const Containers::StringView file, const Containers::ArrayView<const UnsignedInt> images, const UnsignedInt meshCount, const UnsignedInt threadCount, const bool optimizeMeshes, const UnsignedInt lodCount): _importerPlugin{importerPlugin}, _file{file}, _optimizeMeshes{optimizeMeshes}, _lodCount{lodCount} {
+    for(const UnsignedInt image: images)
+        _jobs.push_back({Asset::Type::Image, image});
+    for(UnsignedInt i = 0; i != meshCount; ++i)
+        _jobs.push_back({Asset::Type::Mesh, i});
+
+    /* Check the optimizer plugin here so a missing plugin is reported just
+       once and not by every worker */
+    if(_optimizeMeshes || _lodCount) {
+        PluginManager::Manager<Trade::AbstractSceneConverter> manager;
+        _useMeshOptimizer = !!(manager.load("MeshOptimizerSceneConverter") & PluginManager::LoadState::Loaded);
+        if(!_useMeshOptimizer && _optimizeMeshes)
+            Warning{} << "Meshes won't be reordered for the vertex cache and overdraw";
+        if(!_useMeshOptimizer && _lodCount)
+            Warning{} << "Meshes won't have simplified levels of detail";
+    }
+
+    for(UnsignedInt i = 0; i != threadCount; ++i)
+        _workers.emplace_back(&AssetLoader::workerLoop, this);
+}
+
+AssetLoader::~AssetLoader() {
+    _cancel = true;
+    for(std::thread& worker: _workers) worker.join();
+}
+
+void AssetLoader::loadPlugins(Plugins& plugins) const {
+    plugins.importer = plugins.importerManager.loadAndInstantiate(_importerPlugin);
+    if(plugins.importer && !plugins.importer->openFile(_file))
+        plugins.importer = nullptr;
+
+    if(_useMeshOptimizer && _optimizeMeshes)
+        plugins.meshOptimizer = plugins.converterManager.loadAndInstantiate("MeshOptimizerSceneConverter");
+    if(_useMeshOptimizer && _lodCount) {
+        plugins.meshSimplifier = plugins.converterManager.loadAndInstantiate("MeshOptimizerSceneConverter");
+        if(plugins.meshSimplifier)
+            plugins.meshSimplifier->configuration().setValue("simplify", true);
+    }
+}
+
+AssetLoader::Asset AssetLoader::import(Plugins& plugins, const Job& job) const {
+    Asset asset{job.type, job.id, {}, {}, {}, 0, 0};
+    if(!plugins.importer) return asset;
+
+    if(job.type == Asset::Type::Image) {
+        asset.image = plugins.importer->image2D(job.id);
+        return asset;
+    }
+
+    asset.mesh = plugins.importer->mesh(job.id);
+    if(!asset.mesh) return asset;
+
+    asset.importedVertexCount = asset.mesh->vertexCount();
+    asset.importedDataSize = asset.mesh->indexData().size() + asset.mesh->vertexData().size();
+    if(_optimizeMeshes &&
+       asset.mesh->primitive() == MeshPrimitive::Triangles &&
+       asset.mesh->hasAttribute(Trade::MeshAttribute::Position))
+        asset.mesh = optimize(*asset.mesh, plugins.meshOptimizer.get());
+
+    /* Each level is simplified from the full mesh to a quarter of the
+       indices of the previous level. The simplifier stops earlier if it'd
+       exceed the error threshold, and there's no point in adding levels that
+       aren't considerably smaller. */
+    if(plugins.meshSimplifier &&
+       asset.mesh->primitive() == MeshPrimitive::Triangles &&
+       asset.mesh->isIndexed() &&
+       asset.mesh->hasAttribute(Trade::MeshAttribute::Position))
+    {
+        UnsignedInt indexCount = asset.mesh->indexCount();
+        for(UnsignedInt level = 1; level <= _lodCount; ++level) {
+            plugins.meshSimplifier->configuration().setValue(
+                "simplifyTargetIndexCountThreshold",
+                Math::pow(0.25f, Float(level)));
+            Containers::Optional<Trade::MeshData> simplified =
+                plugins.meshSimplifier->convert(*asset.mesh);
+            if(!simplified || simplified->indexCount() > indexCount/4*3)
+                break;
+
+            indexCount = simplified->indexCount();
+            arrayAppend(asset.lods, std::move(*simplified));
+        }
+    }
+
+    return asset;
+}
+
+AssetLoader::Asset AssetLoader::handOver(Asset&& asset) {
+    ++_handedOver;
+    if(asset.mesh) {
+        _importedVertexCount += asset.importedVertexCount;
+        _importedMeshDataSize += asset.importedDataSize;
+        _vertexCount += asset.mesh->vertexCount();
+        _meshDataSize += asset.mesh->indexData().size() + asset.mesh->vertexData().size();
+    }
+    return std::move(asset);
+}
+
+void AssetLoader::workerLoop() {
+    /* Plugin managers register plugins in global state and importers such
+       as AnySceneImporter load other plugins while opening the file, so only
+       one worker at a time may do that */
+    Containers::Pointer<Plugins> plugins;
+    {
+        std::lock_guard<std::mutex> lock{_pluginMutex};
+        plugins.emplace();
+        loadPlugins(*plugins);
+    }
+
+    /* Even if opening the file fails, go through the jobs so the main thread
+       gets all of them marked as failed */
+    std::size_t job;
+    while(!_cancel && (job = _nextJob++) < _jobs.size()) {
+        Asset asset = import(*plugins, _jobs[job]);
+
+        std::lock_guard<std::mutex> lock{_mutex};
+        _finished.push_back(std::move(asset));
+    }
+
+    /* Unloading goes through the same global state as loading */
+    std::lock_guard<std::mutex> lock{_pluginMutex};
+    plugins = nullptr;
+}
+
+Containers::Optional<AssetLoader::Asset> AssetLoader::next() {
+    if(_workers.empty()) {
+        if(_nextJob == _jobs.size()) return {};
+
+        if(!_plugins) {
+            _plugins.emplace();
+            loadPlugins(*_plugins);
+        }
+
+        return handOver(import(*_plugins, _jobs[_nextJob++]));
+    }
+
+    std::lock_guard<std::mutex> lock{_mutex};
+    if(_finished.empty()) return {};
+
+    Asset asset = std::move(_finished.back());
+    _finished.pop_back();
+    return handOver(std::move(asset));
+}
+
+}}
@@ -0,0 +1,158 @@
+#ifndef Magnum_Examples_Viewer_AssetLoader_h
+#define Magnum_Examples_Viewer_AssetLoader_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/Pointer.h>
+#include <Corrade/Containers/String.h>
+#include <Magnum/Trade/ImageData.h>
+#include <Magnum/Trade/MeshData.h>
+
+namespace Magnum { namespace Examples {
+
+/* Imports images and meshes of a file on a pool of worker threads and hands
+   them over to the main thread, which uploads them to the GPU. Neither the
+   importers nor the plugin manager are thread-safe, so each worker opens the
+   file with its own, and loading and unloading of the plugins is serialized
+   as it goes through global plugin state. For the same reason the caller
+   shouldn't load or unload any plugins while the workers are running.
+   Optionally, the meshes are processed to take less memory and be faster to
+   render before being handed over. */
+class AssetLoader {
+    public:
+        /* An imported image or mesh, the data are NullOpt if the import
+           failed. For meshes there are also simplified levels of detail, if
+           requested, and the vertex count and the index and vertex data size
+           before processing. */
+        struct Asset {
+            enum class Type: UnsignedByte { Image, Mesh } type;
+            UnsignedInt id;
+            Containers::Optional<Trade::ImageData2D> image;
+            Containers::Optional<Trade::MeshData> mesh;
+            Containers::Array<Trade::MeshData> lods;
+            UnsignedInt importedVertexCount;
+            std::size_t importedDataSize;
+        };
+
+        /* Imports given 2D images and all meshes of the file. If threadCount
+           is zero, each asset is imported on the calling thread in next()
+           instead. If optimizeMeshes is set, triangle meshes get flat normals
+           generated if they have none, duplicate vertices removed, vertices
+           and indices reordered for the post-transform cache and overdraw if
+           the MeshOptimizerSceneConverter plugin is available, normals packed
+           to 16-bit integers, texture coordinates to half-floats except on
+           ES2 and WebGL 1 and indices to 16 bits if possible. Attributes not
+           used for rendering are dropped. If lodCount is non-zero and the
+           plugin is available, indexed triangle meshes get up to lodCount
+           simplified levels, each with roughly a quarter of the triangles of
+           the previous one. */
+        explicit AssetLoader(Containers::StringView importerPlugin,
+            Containers::StringView file,
+            Containers::ArrayView<const UnsignedInt> images,
+            UnsignedInt meshCount, UnsignedInt threadCount,
+            bool optimizeMeshes, UnsignedInt lodCount);
+
+        /* Abandons assets that weren't imported yet and waits for the
+           workers */
+        ~AssetLoader();
+
+        /* Count of all assets to import */
+        std::size_t count() const { return _jobs.size(); }
+
+        /* Count of assets handed over by next() */
+        std::size_t finishedCount() const { return _handedOver; }
+
+        bool isDone() const { return _handedOver == _jobs.size(); }
+
+        /* Total vertex count and index and vertex data size of meshes handed
+           over by next(), as imported and after processing. Meshes that
+           failed to import aren't counted. */
+        std::size_t importedVertexCount() const { return _importedVertexCount; }
+        std::size_t vertexCount() const { return _vertexCount; }
+        std::size_t importedMeshDataSize() const { return _importedMeshDataSize; }
+        std::size_t meshDataSize() const { return _meshDataSize; }
+
+        /* Take an imported asset, NullOpt if none is ready yet */
+        Containers::Optional<Asset> next();
+
+    private:
+        struct Job {
+            Asset::Type type;
+            UnsignedInt id;
+        };
+
+        /* Plugin managers and plugin instances of one thread */
+        struct Plugins;
+
+        void workerLoop();
+
+        /* Open the file with a new importer and load the mesh optimizer and
+           simplifier if needed. The importer is null if that fails, the
+           optimizer and simplifier are null if not needed or not
+           available. */
+        void loadPlugins(Plugins& plugins) const;
+
+        Asset import(Plugins& plugins, const Job& job) const;
+
+        /* Counts the mesh statistics and passes the asset through */
+        Asset handOver(Asset&& asset);
+
+        Containers::String _importerPlugin, _file;
+        bool _optimizeMeshes, _useMeshOptimizer = false;
+        UnsignedInt _lodCount;
+        std::vector<Job> _jobs;
+        std::size_t _handedOver = 0;
+        std::size_t _importedVertexCount = 0, _vertexCount = 0,
+            _importedMeshDataSize = 0, _meshDataSize = 0;
+
+        std::vector<std::thread> _workers;
+        std::atomic<std::size_t> _nextJob{0};
+        std::atomic<bool> _cancel{false};
+
+        /* Imported assets not handed over yet, guarded by _mutex */
+        std::mutex _mutex;
+        std::vector<Asset> _finished;
+
+        /* Held by workers while creating or destroying their Plugins */
+        std::mutex _pluginMutex;
+
+        /* Used by next() if there are no workers */
+        Containers::Pointer<Plugins> _plugins;
+};
+
+}}
+
+#endif
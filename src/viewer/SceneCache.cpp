@@ -0,0 +1,658 @@
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SceneCache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <sys/stat.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Containers/Pair.h>
+#include <Corrade/Containers/StridedArrayView.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Utility/Algorithms.h>
+#include <Corrade/Utility/Debug.h>
+#include <Corrade/Utility/Sha1.h>
+#include <Magnum/Mesh.h>
+#include <Magnum/PixelFormat.h>
+#include <Magnum/Sampler.h>
+#include <Magnum/VertexFormat.h>
+#include <Magnum/Math/Color.h>
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Math/Matrix4.h>
+#include <Magnum/Trade/ImageData.h>
+#include <Magnum/Trade/MeshData.h>
+#include <Magnum/Trade/PhongMaterialData.h>
+#include <Magnum/Trade/SceneData.h>
+#include <Magnum/Trade/TextureData.h>
+
+namespace Magnum { namespace Examples {
+
+namespace {
+
+/* The records are written as they are in memory, so the file is usable only
+   on the same platform. Enum values are stored as-is as well, which makes it
+   tied to the Magnum version too. Bump the version when changing the
+   layout. */
+constexpr char Magic[8]{'V', 'W', 'R', 'C', 'A', 'C', 'H', 'E'};
+constexpr UnsignedInt Version = 2;
+
+/* A range in the payload, the offset is always aligned to 16 bytes */
+struct Chunk {
+    UnsignedLong offset, size;
+};
+
+struct SceneRecord {
+    UnsignedLong mappingBound;
+    Chunk parentMapping, parents;
+    Chunk transformationMapping, transformations;
+    /* Materials share the mapping with meshes */
+    Chunk meshMapping, meshes, meshMaterials;
+};
+
+struct Header {
+    char magic[8];
+    UnsignedInt version;
+    UnsignedInt textureCount, materialCount, meshCount, imageCount;
+    UnsignedInt hasScene;
+    UnsignedLong sourceModificationTime;
+    Utility::Sha1::Digest sourceDigest;
+    /* SHA-1 of the whole file except for this field */
+    Utility::Sha1::Digest digest;
+    UnsignedLong payloadOffset, payloadSize;
+    SceneRecord scene;
+};
+
+struct TextureRecord {
+    UnsignedInt present;
+    UnsignedInt image;
+    SamplerFilter minificationFilter, magnificationFilter;
+    SamplerMipmap mipmapFilter;
+    Math::Vector3<SamplerWrapping> wrapping;
+};
+
+struct MaterialRecord {
+    UnsignedInt present;
+    /* -1 if the material has no diffuse texture */
+    Int diffuseTexture;
+    Color4 diffuseColor;
+};
+
+struct MeshRecord {
+    UnsignedInt present;
+    MeshPrimitive primitive;
+    UnsignedInt indexed;
+    MeshIndexType indexType;
+    UnsignedInt vertexCount;
+    UnsignedInt attributeCount;
+    Chunk indexData, vertexData, attributes;
+};
+
+struct AttributeRecord {
+    Trade::MeshAttribute name;
+    UnsignedShort arraySize;
+    VertexFormat format;
+    /* Relative to the vertex data */
+    UnsignedInt offset;
+    Int stride;
+};
+
+struct ImageRecord {
+    UnsignedInt present;
+    PixelFormat format;
+    Vector2i size;
+    Int alignment, rowLength, imageHeight;
+    Vector3i skip;
+    Chunk data;
+};
+
+/* Offsets of the record arrays in the file, they're followed by the payload
+   aligned to 16 bytes */
+struct Layout {
+    explicit Layout(UnsignedInt textureCount, UnsignedInt materialCount, UnsignedInt meshCount, UnsignedInt imageCount):
+        textures{sizeof(Header)},
+        materials{textures + textureCount*sizeof(TextureRecord)},
+        meshes{materials + materialCount*sizeof(MaterialRecord)},
+        images{meshes + meshCount*sizeof(MeshRecord)},
+        payload{(images + imageCount*sizeof(ImageRecord) + 15) & ~std::size_t{15}} {}
+
+    explicit Layout(const Header& header): Layout{header.textureCount, header.materialCount, header.meshCount, header.imageCount} {}
+
+    std::size_t textures, materials, meshes, images, payload;
+};
+
+/* Modification time and SHA-1 of the file contents, NullOpt if the file can't
+   be read */
+Containers::Optional<Containers::Pair<UnsignedLong, Utility::Sha1::Digest>> sourceKey(const Containers::StringView filename) {
+    struct stat status;
+    if(stat(Containers::String::nullTerminatedView(filename).data(), &status) != 0)
+        return {};
+
+    const Containers::Optional<Containers::Array<const char, Utility::Path::MapDeleter>> data = Utility::Path::mapRead(filename);
+    if(!data) return {};
+
+    Utility::Sha1 sha1;
+    sha1 << *data;
+    return Containers::pair(UnsignedLong(status.st_mtime), sha1.digest());
+}
+
+Utility::Sha1::Digest cacheDigest(const Containers::ArrayView<const char> data) {
+    Utility::Sha1 sha1;
+    sha1 << data.prefix(offsetof(Header, digest));
+    sha1 << data.exceptPrefix(offsetof(Header, digest) + sizeof(Utility::Sha1::Digest));
+    return sha1.digest();
+}
+
+bool isValid(const Chunk& chunk, const UnsignedLong payloadSize, const std::size_t typeSize) {
+    return chunk.offset % 16 == 0 && chunk.offset <= payloadSize &&
+        chunk.size <= payloadSize - chunk.offset && chunk.size % typeSize == 0;
+}
+
+Containers::ArrayView<const char> chunkData(const Containers::ArrayView<const char> payload, const Chunk& chunk) {
+    return payload.sliceSize(chunk.offset, chunk.size);
+}
+
+/* GL::samplerFilter() and friends assert on values outside of these */
+bool isValid(const TextureRecord& texture, const UnsignedInt imageCount) {
+    if(texture.image >= imageCount) return false;
+    for(const SamplerFilter filter: {texture.minificationFilter, texture.magnificationFilter}) {
+        if(filter != SamplerFilter::Nearest && filter != SamplerFilter::Linear)
+            return false;
+    }
+    if(texture.mipmapFilter != SamplerMipmap::Base &&
+       texture.mipmapFilter != SamplerMipmap::Nearest &&
+       texture.mipmapFilter != SamplerMipmap::Linear)
+        return false;
+    for(std::size_t i = 0; i != 3; ++i) {
+        const SamplerWrapping wrapping = texture.wrapping[i];
+        if(wrapping != SamplerWrapping::Repeat &&
+           wrapping != SamplerWrapping::MirroredRepeat &&
+           wrapping != SamplerWrapping::ClampToEdge &&
+           wrapping != SamplerWrapping::ClampToBorder &&
+           wrapping != SamplerWrapping::MirrorClampToEdge)
+            return false;
+    }
+    return true;
+}
+
+/* The attribute has to fit into the vertex data for all vertices, with
+   the stride going in either direction */
+bool isValid(const AttributeRecord& attribute, const UnsignedInt vertexCount, const UnsignedLong vertexDataSize) {
+    if(attribute.format == VertexFormat{} ||
+       isVertexFormatImplementationSpecific(attribute.format))
+        return false;
+    if(!vertexCount) return attribute.offset <= vertexDataSize;
+
+    const Long elementSize = vertexFormatSize(attribute.format)*Math::max(attribute.arraySize, UnsignedShort{1});
+    const Long first = attribute.offset;
+    const Long last = first + Long(attribute.stride)*(vertexCount - 1);
+    return Math::min(first, last) >= 0 &&
+        UnsignedLong(Math::max(first, last) + elementSize) <= vertexDataSize;
+}
+
+/* Same as the size calculation in Trade::ImageData */
+bool isValid(const ImageRecord& image) {
+    if(image.format == PixelFormat{} ||
+       isPixelFormatImplementationSpecific(image.format))
+        return false;
+    if(image.alignment != 1 && image.alignment != 2 &&
+       image.alignment != 4 && image.alignment != 8)
+        return false;
+    if(image.size.min() < 0 || image.rowLength < 0 || image.imageHeight < 0 ||
+       image.skip.min() < 0)
+        return false;
+    if(!image.size.product()) return true;
+
+    const UnsignedLong pixelSize = pixelFormatSize(image.format);
+    const UnsignedLong rowLength = image.rowLength ? image.rowLength : image.size.x();
+    const UnsignedLong height = image.imageHeight ? image.imageHeight : image.size.y();
+    const UnsignedLong rowSize = (rowLength*pixelSize + image.alignment - 1)/image.alignment*image.alignment;
+    return image.skip.x()*pixelSize + image.skip.y()*rowSize +
+        image.skip.z()*rowSize*height + rowSize*height <= image.data.size;
+}
+
+/* Mapped objects have to be less than the mapping bound, the fields have to
+   be valid IDs or -1 where allowed */
+bool isValid(const Containers::ArrayView<const UnsignedInt> mapping, const UnsignedLong mappingBound) {
+    for(const UnsignedInt object: mapping)
+        if(object >= mappingBound) return false;
+    return true;
+}
+
+bool isValid(const Containers::ArrayView<const Int> ids, const UnsignedLong bound) {
+    for(const Int id: ids)
+        if(id < -1 || (id != -1 && UnsignedLong(id) >= bound)) return false;
+    return true;
+}
+
+Chunk appendChunk(Containers::Array<char>& payload, const Containers::ArrayView<const void> data) {
+    arrayResize(payload, ValueInit, (payload.size() + 15) & ~std::size_t{15});
+    const Chunk chunk{payload.size(), data.size()};
+    arrayAppend(payload, Containers::arrayCast<const char>(data));
+    return chunk;
+}
+
+}
+
+Containers::Optional<SceneCache> SceneCache::open(const Containers::StringView filename, const Containers::StringView sourceFilename) {
+    if(!Utility::Path::exists(filename)) return {};
+
+    Containers::Optional<Containers::Array<const char, Utility::Path::MapDeleter>> data = Utility::Path::mapRead(filename);
+    if(!data || data->size() < sizeof(Header)) return {};
+
+    const Header& header = *reinterpret_cast<const Header*>(data->data());
+    if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+       header.version != Version)
+        return {};
+
+    /* The payload is right after the records and spans the rest of the
+       file */
+    const Layout layout{header};
+    if(data->size() < layout.payload ||
+       header.payloadOffset != layout.payload ||
+       header.payloadSize != data->size() - layout.payload)
+        return {};
+
+    /* A truncated or otherwise corrupted file is caught by the checksum,
+       which is checked before anything else is looked at. The records are
+       then what SceneCacheWriter made from valid Trade data. */
+    if(cacheDigest(*data) != header.digest)
+        return {};
+
+    /* In addition, all ranges, sizes and IDs are checked to be consistent
+       with each other. Vertex and pixel formats, attribute names, the mesh
+       primitive and index values aren't validated, those are trusted based
+       on the checksum. */
+    const Containers::ArrayView<const char> payload = data->sliceSize(layout.payload, header.payloadSize);
+    const TextureRecord* const textures = reinterpret_cast<const TextureRecord*>(data->data() + layout.textures);
+    for(UnsignedInt i = 0; i != header.textureCount; ++i) {
+        if(textures[i].present && !isValid(textures[i], header.imageCount))
+            return {};
+    }
+    const MaterialRecord* const materials = reinterpret_cast<const MaterialRecord*>(data->data() + layout.materials);
+    for(UnsignedInt i = 0; i != header.materialCount; ++i) {
+        if(materials[i].present && (materials[i].diffuseTexture < -1 ||
+           (materials[i].diffuseTexture != -1 &&
+            UnsignedInt(materials[i].diffuseTexture) >= header.textureCount)))
+            return {};
+    }
+    const MeshRecord* const meshes = reinterpret_cast<const MeshRecord*>(data->data() + layout.meshes);
+    for(UnsignedInt i = 0; i != header.meshCount; ++i) {
+        const MeshRecord& mesh = meshes[i];
+        if(!mesh.present) continue;
+
+        if(!isValid(mesh.indexData, header.payloadSize, 1) ||
+           !isValid(mesh.vertexData, header.payloadSize, 1) ||
+           !isValid(mesh.attributes, header.payloadSize, sizeof(AttributeRecord)) ||
+           mesh.attributes.size != mesh.attributeCount*sizeof(AttributeRecord))
+            return {};
+
+        if(mesh.indexed && (
+            (mesh.indexType != MeshIndexType::UnsignedByte &&
+             mesh.indexType != MeshIndexType::UnsignedShort &&
+             mesh.indexType != MeshIndexType::UnsignedInt) ||
+            mesh.indexData.size % meshIndexTypeSize(mesh.indexType) != 0))
+            return {};
+
+        for(const AttributeRecord& attribute: Containers::arrayCast<const AttributeRecord>(chunkData(payload, mesh.attributes))) {
+            if(!isValid(attribute, mesh.vertexCount, mesh.vertexData.size))
+                return {};
+        }
+    }
+    const ImageRecord* const images = reinterpret_cast<const ImageRecord*>(data->data() + layout.images);
+    for(UnsignedInt i = 0; i != header.imageCount; ++i) {
+        if(images[i].present && (
+            !isValid(images[i].data, header.payloadSize, 1) ||
+            !isValid(images[i])))
+            return {};
+    }
+    const SceneRecord& scene = header.scene;
+    if(header.hasScene && (
+        !isValid(scene.parentMapping, header.payloadSize, sizeof(UnsignedInt)) ||
+        !isValid(scene.parents, header.payloadSize, sizeof(Int)) ||
+        scene.parents.size != scene.parentMapping.size ||
+        !isValid(scene.transformationMapping, header.payloadSize, sizeof(UnsignedInt)) ||
+        !isValid(scene.transformations, header.payloadSize, sizeof(Matrix4)) ||
+        scene.transformations.size/sizeof(Matrix4) != scene.transformationMapping.size/sizeof(UnsignedInt) ||
+        !isValid(scene.meshMapping, header.payloadSize, sizeof(UnsignedInt)) ||
+        !isValid(scene.meshes, header.payloadSize, sizeof(UnsignedInt)) ||
+        !isValid(scene.meshMaterials, header.payloadSize, sizeof(Int)) ||
+        scene.meshes.size != scene.meshMapping.size ||
+        scene.meshMaterials.size != scene.meshMapping.size))
+        return {};
+    if(header.hasScene) {
+        const Containers::ArrayView<const UnsignedInt> parentMapping = Containers::arrayCast<const UnsignedInt>(chunkData(payload, scene.parentMapping));
+        const Containers::ArrayView<const Int> parents = Containers::arrayCast<const Int>(chunkData(payload, scene.parents));
+        const Containers::ArrayView<const UnsignedInt> meshIds = Containers::arrayCast<const UnsignedInt>(chunkData(payload, scene.meshes));
+        if(scene.mappingBound > ~UnsignedInt{} ||
+           !isValid(parentMapping, scene.mappingBound) ||
+           !isValid(parents, scene.mappingBound) ||
+           !isValid(Containers::arrayCast<const UnsignedInt>(chunkData(payload, scene.transformationMapping)), scene.mappingBound) ||
+           !isValid(Containers::arrayCast<const UnsignedInt>(chunkData(payload, scene.meshMapping)), scene.mappingBound) ||
+           !isValid(meshIds, header.meshCount) ||
+           !isValid(Containers::arrayCast<const Int>(chunkData(payload, scene.meshMaterials)), header.materialCount))
+            return {};
+
+        /* The viewer sets parents of all objects in the hierarchy, so the
+           parents have to be in the hierarchy as well */
+        Containers::Array<bool> inHierarchy{ValueInit, std::size_t(scene.mappingBound)};
+        for(const UnsignedInt object: parentMapping)
+            inHierarchy[object] = true;
+        for(const Int parent: parents)
+            if(parent != -1 && !inHierarchy[parent]) return {};
+    }
+
+    /* Check the source file last, as it needs to read all of it */
+    const Containers::Optional<Containers::Pair<UnsignedLong, Utility::Sha1::Digest>> key = sourceKey(sourceFilename);
+    if(!key || key->first() != header.sourceModificationTime ||
+       key->second() != header.sourceDigest)
+        return {};
+
+    return SceneCache{*std::move(data)};
+}
+
+SceneCache::SceneCache(Containers::Array<const char, Utility::Path::MapDeleter>&& data): _data{std::move(data)} {}
+
+UnsignedInt SceneCache::textureCount() const {
+    return reinterpret_cast<const Header*>(_data.data())->textureCount;
+}
+
+UnsignedInt SceneCache::materialCount() const {
+    return reinterpret_cast<const Header*>(_data.data())->materialCount;
+}
+
+UnsignedInt SceneCache::meshCount() const {
+    return reinterpret_cast<const Header*>(_data.data())->meshCount;
+}
+
+UnsignedInt SceneCache::imageCount() const {
+    return reinterpret_cast<const Header*>(_data.data())->imageCount;
+}
+
+Containers::Optional<Trade::TextureData> SceneCache::texture(const UnsignedInt id) const {
+    const Header& header = *reinterpret_cast<const Header*>(_data.data());
+    const TextureRecord& record = reinterpret_cast<const TextureRecord*>(_data.data() + Layout{header}.textures)[id];
+    if(!record.present) return {};
+
+    return Trade::TextureData{Trade::TextureType::Texture2D,
+        record.minificationFilter, record.magnificationFilter,
+        record.mipmapFilter, record.wrapping, record.image};
+}
+
+Containers::Optional<Trade::PhongMaterialData> SceneCache::material(const UnsignedInt id) const {
+    const Header& header = *reinterpret_cast<const Header*>(_data.data());
+    const MaterialRecord& record = reinterpret_cast<const MaterialRecord*>(_data.data() + Layout{header}.materials)[id];
+    if(!record.present) return {};
+
+    if(record.diffuseTexture == -1)
+        return Trade::MaterialData{Trade::MaterialType::Phong, {
+            {Trade::MaterialAttribute::DiffuseColor, record.diffuseColor}
+        }}.as<Trade::PhongMaterialData>();
+
+    return Trade::MaterialData{Trade::MaterialType::Phong, {
+        {Trade::MaterialAttribute::DiffuseColor, record.diffuseColor},
+        {Trade::MaterialAttribute::DiffuseTexture, UnsignedInt(record.diffuseTexture)}
+    }}.as<Trade::PhongMaterialData>();
+}
+
+Containers::Optional<Trade::MeshData> SceneCache::mesh(const UnsignedInt id) const {
+    const Header& header = *reinterpret_cast<const Header*>(_data.data());
+    const MeshRecord& record = reinterpret_cast<const MeshRecord*>(_data.data() + Layout{header}.meshes)[id];
+    if(!record.present) return {};
+
+    const Containers::ArrayView<const char> payload = _data.sliceSize(header.payloadOffset, header.payloadSize);
+    const Containers::ArrayView<const char> vertexData = chunkData(payload, record.vertexData);
+    const Containers::ArrayView<const AttributeRecord> attributeRecords = Containers::arrayCast<const AttributeRecord>(chunkData(payload, record.attributes));
+
+    Containers::Array<Trade::MeshAttributeData> attributes{record.attributeCount};
+    for(UnsignedInt i = 0; i != record.attributeCount; ++i) {
+        const AttributeRecord& attribute = attributeRecords[i];
+        attributes[i] = Trade::MeshAttributeData{attribute.name,
+            attribute.format,
+            Containers::StridedArrayView1D<const void>{vertexData,
+                vertexData.data() + attribute.offset, record.vertexCount,
+                attribute.stride},
+            attribute.arraySize};
+    }
+
+    if(!record.indexed)
+        return Trade::MeshData{record.primitive,
+            Trade::DataFlags{}, vertexData, std::move(attributes),
+            record.vertexCount};
+
+    const Containers::ArrayView<const char> indexData = chunkData(payload, record.indexData);
+    return Trade::MeshData{record.primitive,
+        Trade::DataFlags{}, indexData,
+        Trade::MeshIndexData{record.indexType, indexData},
+        Trade::DataFlags{}, vertexData, std::move(attributes),
+        record.vertexCount};
+}
+
+Containers::Optional<Trade::ImageData2D> SceneCache::image(const UnsignedInt id) const {
+    const Header& header = *reinterpret_cast<const Header*>(_data.data());
+    const ImageRecord& record = reinterpret_cast<const ImageRecord*>(_data.data() + Layout{header}.images)[id];
+    if(!record.present) return {};
+
+    const Containers::ArrayView<const char> payload = _data.sliceSize(header.payloadOffset, header.payloadSize);
+    return Trade::ImageData2D{PixelStorage{}
+            .setAlignment(record.alignment)
+            .setRowLength(record.rowLength)
+            .setImageHeight(record.imageHeight)
+            .setSkip(record.skip),
+        record.format, record.size,
+        Trade::DataFlags{}, chunkData(payload, record.data)};
+}
+
+Containers::Optional<Trade::SceneData> SceneCache::scene() const {
+    const Header& header = *reinterpret_cast<const Header*>(_data.data());
+    if(!header.hasScene) return {};
+
+    const SceneRecord& record = header.scene;
+    const Containers::ArrayView<const char> payload = _data.sliceSize(header.payloadOffset, header.payloadSize);
+    const Containers::StridedArrayView1D<const UnsignedInt> meshMapping = Containers::arrayCast<const UnsignedInt>(chunkData(payload, record.meshMapping));
+    Containers::Array<Trade::SceneFieldData> fields{InPlaceInit, {
+        Trade::SceneFieldData{Trade::SceneField::Parent,
+            Containers::stridedArrayView(Containers::arrayCast<const UnsignedInt>(chunkData(payload, record.parentMapping))),
+            Containers::stridedArrayView(Containers::arrayCast<const Int>(chunkData(payload, record.parents)))},
+        Trade::SceneFieldData{Trade::SceneField::Transformation,
+            Containers::stridedArrayView(Containers::arrayCast<const UnsignedInt>(chunkData(payload, record.transformationMapping))),
+            Containers::stridedArrayView(Containers::arrayCast<const Matrix4>(chunkData(payload, record.transformations)))},
+        Trade::SceneFieldData{Trade::SceneField::Mesh, meshMapping,
+            Containers::stridedArrayView(Containers::arrayCast<const UnsignedInt>(chunkData(payload, record.meshes)))},
+        Trade::SceneFieldData{Trade::SceneField::MeshMaterial, meshMapping,
+            Containers::stridedArrayView(Containers::arrayCast<const Int>(chunkData(payload, record.meshMaterials)))}
+    }};
+
+    return Trade::SceneData{Trade::SceneMappingType::UnsignedInt,
+        record.mappingBound, Trade::DataFlags{}, payload, std::move(fields)};
+}
+
+SceneCacheWriter::SceneCacheWriter(const Containers::StringView sourceFilename, const UnsignedInt textureCount, const UnsignedInt materialCount, const UnsignedInt meshCount, const UnsignedInt imageCount): _complete{true}, _records{ValueInit, Layout{textureCount, materialCount, meshCount, imageCount}.payload} {
+    Header& header = *reinterpret_cast<Header*>(_records.data());
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.textureCount = textureCount;
+    header.materialCount = materialCount;
+    header.meshCount = meshCount;
+    header.imageCount = imageCount;
+    header.payloadOffset = _records.size();
+
+    const Containers::Optional<Containers::Pair<UnsignedLong, Utility::Sha1::Digest>> key = sourceKey(sourceFilename);
+    if(!key) {
+        _complete = false;
+        return;
+    }
+
+    header.sourceModificationTime = key->first();
+    header.sourceDigest = key->second();
+}
+
+void SceneCacheWriter::setTexture(const UnsignedInt id, const Trade::TextureData& texture) {
+    const Header& header = *reinterpret_cast<const Header*>(_records.data());
+    TextureRecord& record = reinterpret_cast<TextureRecord*>(_records.data() + Layout{header}.textures)[id];
+    record.present = 1;
+    record.image = texture.image();
+    record.minificationFilter = texture.minificationFilter();
+    record.magnificationFilter = texture.magnificationFilter();
+    record.mipmapFilter = texture.mipmapFilter();
+    record.wrapping = texture.wrapping();
+}
+
+void SceneCacheWriter::setMaterial(const UnsignedInt id, const Trade::PhongMaterialData& material) {
+    const Header& header = *reinterpret_cast<const Header*>(_records.data());
+    MaterialRecord& record = reinterpret_cast<MaterialRecord*>(_records.data() + Layout{header}.materials)[id];
+    record.present = 1;
+    record.diffuseColor = material.diffuseColor();
+    record.diffuseTexture = material.hasAttribute(Trade::MaterialAttribute::DiffuseTexture) ?
+        Int(material.diffuseTexture()) : -1;
+}
+
+void SceneCacheWriter::setMesh(const UnsignedInt id, const Trade::MeshData& mesh) {
+    /* Size of these isn't known, so the indices couldn't be copied to a
+       contiguous array and the attributes couldn't be checked when opening
+       the cache */
+    if(mesh.isIndexed() && isMeshIndexTypeImplementationSpecific(mesh.indexType())) {
+        Warning{} << "Can't cache mesh" << id << "with" << mesh.indexType();
+        _complete = false;
+        return;
+    }
+    for(UnsignedInt i = 0; i != mesh.attributeCount(); ++i) {
+        if(isVertexFormatImplementationSpecific(mesh.attributeFormat(i))) {
+            Warning{} << "Can't cache mesh" << id << "with" << mesh.attributeFormat(i);
+            _complete = false;
+            return;
+        }
+    }
+
+    const Header& header = *reinterpret_cast<const Header*>(_records.data());
+    MeshRecord& record = reinterpret_cast<MeshRecord*>(_records.data() + Layout{header}.meshes)[id];
+    record.present = 1;
+    record.primitive = mesh.primitive();
+    record.vertexCount = mesh.vertexCount();
+    record.attributeCount = mesh.attributeCount();
+
+    /* The index buffer can be strided, make it contiguous */
+    if(mesh.isIndexed()) {
+        const Containers::StridedArrayView2D<const char> indices = mesh.indices();
+        Containers::Array<char> indexData{NoInit, indices.size()[0]*indices.size()[1]};
+        Utility::copy(indices, Containers::StridedArrayView2D<char>{indexData, indices.size()});
+        record.indexed = 1;
+        record.indexType = mesh.indexType();
+        record.indexData = appendChunk(_payload, indexData);
+    }
+
+    record.vertexData = appendChunk(_payload, mesh.vertexData());
+
+    Containers::Array<AttributeRecord> attributes{ValueInit, mesh.attributeCount()};
+    for(UnsignedInt i = 0; i != mesh.attributeCount(); ++i) {
+        attributes[i].name = mesh.attributeName(i);
+        attributes[i].arraySize = mesh.attributeArraySize(i);
+        attributes[i].format = mesh.attributeFormat(i);
+        attributes[i].offset = mesh.attributeOffset(i);
+        attributes[i].stride = mesh.attributeStride(i);
+    }
+    record.attributes = appendChunk(_payload, attributes);
+}
+
+void SceneCacheWriter::setImage(const UnsignedInt id, const Trade::ImageData2D& image) {
+    /* Size of these isn't known, so the image couldn't be recreated */
+    if(image.isCompressed() || isPixelFormatImplementationSpecific(image.format())) {
+        Warning{} << "Can't cache image" << id;
+        _complete = false;
+        return;
+    }
+
+    const Header& header = *reinterpret_cast<const Header*>(_records.data());
+    ImageRecord& record = reinterpret_cast<ImageRecord*>(_records.data() + Layout{header}.images)[id];
+    record.present = 1;
+    record.format = image.format();
+    record.size = image.size();
+    record.alignment = image.storage().alignment();
+    record.rowLength = image.storage().rowLength();
+    record.imageHeight = image.storage().imageHeight();
+    record.skip = image.storage().skip();
+    record.data = appendChunk(_payload, image.data());
+}
+
+void SceneCacheWriter::setScene(const Trade::SceneData& scene) {
+    Header& header = *reinterpret_cast<Header*>(_records.data());
+    header.hasScene = 1;
+    SceneRecord& record = header.scene;
+    record.mappingBound = scene.mappingBound();
+
+    /* Split the pairs into separate mapping and field arrays, which is what
+       Trade::SceneData can reference directly */
+    const Containers::Array<Containers::Pair<UnsignedInt, Int>> parents = scene.parentsAsArray();
+    Containers::Array<UnsignedInt> parentMapping{NoInit, parents.size()};
+    Containers::Array<Int> parentFields{NoInit, parents.size()};
+    for(std::size_t i = 0; i != parents.size(); ++i) {
+        parentMapping[i] = parents[i].first();
+        parentFields[i] = parents[i].second();
+    }
+    record.parentMapping = appendChunk(_payload, parentMapping);
+    record.parents = appendChunk(_payload, parentFields);
+
+    const Containers::Array<Containers::Pair<UnsignedInt, Matrix4>> transformations = scene.transformations3DAsArray();
+    Containers::Array<UnsignedInt> transformationMapping{NoInit, transformations.size()};
+    Containers::Array<Matrix4> transformationFields{NoInit, transformations.size()};
+    for(std::size_t i = 0; i != transformations.size(); ++i) {
+        transformationMapping[i] = transformations[i].first();
+        transformationFields[i] = transformations[i].second();
+    }
+    record.transformationMapping = appendChunk(_payload, transformationMapping);
+    record.transformations = appendChunk(_payload, transformationFields);
+
+    const Containers::Array<Containers::Pair<UnsignedInt, Containers::Pair<UnsignedInt, Int>>> meshesMaterials = scene.meshesMaterialsAsArray();
+    Containers::Array<UnsignedInt> meshMapping{NoInit, meshesMaterials.size()};
+    Containers::Array<UnsignedInt> meshFields{NoInit, meshesMaterials.size()};
+    Containers::Array<Int> meshMaterialFields{NoInit, meshesMaterials.size()};
+    for(std::size_t i = 0; i != meshesMaterials.size(); ++i) {
+        meshMapping[i] = meshesMaterials[i].first();
+        meshFields[i] = meshesMaterials[i].second().first();
+        meshMaterialFields[i] = meshesMaterials[i].second().second();
+    }
+    record.meshMapping = appendChunk(_payload, meshMapping);
+    record.meshes = appendChunk(_payload, meshFields);
+    record.meshMaterials = appendChunk(_payload, meshMaterialFields);
+}
+
+bool SceneCacheWriter::save(const Containers::StringView filename) const {
+    if(!_complete) return false;
+
+    Containers::Array<char> data{NoInit, _records.size() + _payload.size()};
+    Utility::copy(Containers::arrayView(_records), data.prefix(_records.size()));
+    Utility::copy(Containers::arrayView(_payload), data.exceptPrefix(_records.size()));
+    Header& header = *reinterpret_cast<Header*>(data.data());
+    header.payloadSize = _payload.size();
+    header.digest = cacheDigest(data);
+    return Utility::Path::write(filename, data);
+}
+
+}}
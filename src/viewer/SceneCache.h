@@ -0,0 +1,102 @@
+#ifndef Magnum_Examples_Viewer_SceneCache_h
+#define Magnum_Examples_Viewer_SceneCache_h
+/*
+    This file is part of Magnum.
+
+    Original authors — credit is appreciated but not required:
+
+        2010, 2011, 2012, 2013, 2014, 2015, 2016, 2017, 2018, 2019,
+        2020, 2021, 2022, 2023, 2024, 2025, 2026
+             — Vladimír Vondruš <mosra@centrum.cz>
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+    this software, either in source code form or as a compiled binary, for any
+    purpose, commercial or non-commercial, and by any means.
+
+    In jurisdictions that recognize copyright laws, the author or authors of
+    this software dedicate any and all copyright interest in the software to
+    the public domain. We make this dedication for the benefit of the public
+    at large and to the detriment of our heirs and successors. We intend this
+    dedication to be an overt act of relinquishment in perpetuity of all
+    present and future rights to this software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Utility/Path.h>
+#include <Magnum/Trade/Trade.h>
+
+namespace Magnum { namespace Examples {
+
+/* Textures, materials, processed meshes, images and the scene hierarchy of a
+   file, serialized into a single file by SceneCacheWriter. The file is
+   memory-mapped and the meshes, images and the scene reference it directly,
+   without any parsing or copying. */
+class SceneCache {
+    public:
+        /* Map a cache file made for given source file. Returns NullOpt if it
+           doesn't exist, is corrupted or was made for a different content or
+           modification time of the source file. */
+        static Containers::Optional<SceneCache> open(Containers::StringView filename, Containers::StringView sourceFilename);
+
+        UnsignedInt textureCount() const;
+        UnsignedInt materialCount() const;
+        UnsignedInt meshCount() const;
+        UnsignedInt imageCount() const;
+
+        /* These return NullOpt for data that failed to import when the cache
+           was made */
+        Containers::Optional<Trade::TextureData> texture(UnsignedInt id) const;
+        Containers::Optional<Trade::PhongMaterialData> material(UnsignedInt id) const;
+        Containers::Optional<Trade::MeshData> mesh(UnsignedInt id) const;
+        Containers::Optional<Trade::ImageData2D> image(UnsignedInt id) const;
+
+        /* NullOpt if the file has no scene */
+        Containers::Optional<Trade::SceneData> scene() const;
+
+    private:
+        explicit SceneCache(Containers::Array<const char, Utility::Path::MapDeleter>&& data);
+
+        Containers::Array<const char, Utility::Path::MapDeleter> _data;
+};
+
+/* Collects data for a SceneCache. Only the diffuse color and texture of the
+   materials and the parent, transformation, mesh and material fields of the
+   scene are stored, that's all the viewer uses. */
+class SceneCacheWriter {
+    public:
+        /* The source file content and modification time are recorded right
+           away, so a file changed during import makes the cache outdated.
+           External files referenced from it aren't considered. */
+        explicit SceneCacheWriter(Containers::StringView sourceFilename, UnsignedInt textureCount, UnsignedInt materialCount, UnsignedInt meshCount, UnsignedInt imageCount);
+
+        void setTexture(UnsignedInt id, const Trade::TextureData& texture);
+        void setMaterial(UnsignedInt id, const Trade::PhongMaterialData& material);
+        void setMesh(UnsignedInt id, const Trade::MeshData& mesh);
+        void setImage(UnsignedInt id, const Trade::ImageData2D& image);
+        void setScene(const Trade::SceneData& scene);
+
+        /* Fails if the source file couldn't be read or some data couldn't be
+           stored */
+        bool save(Containers::StringView filename) const;
+
+    private:
+        bool _complete;
+        /* File header and fixed-size records, followed by the variable-size
+           data */
+        Containers::Array<char> _records;
+        Containers::Array<char> _payload;
+};
+
+}}
+
+#endif
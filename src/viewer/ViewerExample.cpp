@@ -28,21 +28,37 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
 #include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/GrowableArray.h>
 #include <Corrade/Containers/Optional.h>
 #include <Corrade/Containers/Pair.h>
+#include <Corrade/Containers/Pointer.h>
+#include <Corrade/Containers/String.h>
 #include <Corrade/PluginManager/Manager.h>
 #include <Corrade/Utility/Arguments.h>
 #include <Corrade/Utility/DebugStl.h>
+#include <Corrade/Utility/Format.h>
 #include <Magnum/ImageView.h>
 #include <Magnum/Mesh.h>
 #include <Magnum/PixelFormat.h>
+#include <Magnum/GL/Buffer.h>
 #include <Magnum/GL/DefaultFramebuffer.h>
 #include <Magnum/GL/Mesh.h>
 #include <Magnum/GL/Renderer.h>
 #include <Magnum/GL/Texture.h>
 #include <Magnum/GL/TextureFormat.h>
 #include <Magnum/Math/Color.h>
+#include <Magnum/Math/Frustum.h>
+#include <Magnum/Math/FunctionsBatch.h>
+#include <Magnum/Math/Intersection.h>
+#include <Magnum/Math/Range.h>
 #include <Magnum/MeshTools/Compile.h>
 #include <Magnum/Platform/Sdl2Application.h>
 #include <Magnum/SceneGraph/Camera.h>
@@ -57,6 +73,9 @@
 #include <Magnum/Trade/SceneData.h>
 #include <Magnum/Trade/TextureData.h>
 
+#include "AssetLoader.h"
+#include "SceneCache.h"
+
 namespace Magnum { namespace Examples {
 
 using namespace Math::Literals;
@@ -64,6 +83,43 @@ using namespace Math::Literals;
 typedef SceneGraph::Object<SceneGraph::MatrixTransformation3D> Object3D;
 typedef SceneGraph::Scene<SceneGraph::MatrixTransformation3D> Scene3D;
 
+struct InstanceData {
+    Matrix4 transformationMatrix;
+    Matrix3x3 normalMatrix;
+    Color4 color;
+};
+
+/* Filled once a mesh is uploaded, the level count is zero until then.
+   Objects further than lodDistance from the camera use the first simplified
+   level, each next level is used once the distance doubles. */
+struct MeshInfo {
+    Range3D bounds;
+    UnsignedInt levelCount;
+    Float lodDistance;
+};
+
+class BatchedDrawable;
+
+/* An object of the scene hierarchy. The nodes are in depth-first order, so
+   each subtree is a contiguous range. Only the manipulator moves, so the
+   transformations and bounds are relative to it and calculated just once. */
+struct CullingNode {
+    Matrix4 transformation;
+    /* -1 for the manipulator itself */
+    Int parent;
+    /* One after the last node of the subtree */
+    UnsignedInt subtreeEnd;
+    /* Range of drawables of this object in _cullingDrawables, drawables of
+       the whole subtree follow */
+    UnsignedInt drawableOffset, drawableCount;
+    /* Counts of drawables of this object and of the whole subtree that have
+       a mesh uploaded already, updated together with the bounds */
+    UnsignedInt loadedDrawableCount, subtreeLoadedDrawableCount;
+    /* Bounds of meshes of this object and of the whole subtree. Min is larger
+       than max if there's no mesh loaded yet. */
+    Range3D bounds, subtreeBounds;
+};
+
 class ViewerExample: public Platform::Application {
     public:
         explicit ViewerExample(const Arguments& arguments);
@@ -75,44 +131,84 @@ class ViewerExample: public Platform::Application {
         void pointerReleaseEvent(PointerEvent& event) override;
         void pointerMoveEvent(PointerMoveEvent& event) override;
         void scrollEvent(ScrollEvent& event) override;
+        void keyPressEvent(KeyEvent& event) override;
 
         Vector3 positionOnSphere(const Vector2& position) const;
 
-        Shaders::PhongGL _coloredShader;
+        void uploadLoadedAssets();
+        void uploadImage(UnsignedInt id, const Trade::ImageData2D& image);
+        void uploadMesh(UnsignedInt id, const Trade::MeshData& meshData, Containers::ArrayView<const Trade::MeshData> lods);
+        GL::Mesh compileMesh(UnsignedInt id, const Trade::MeshData& meshData);
+
+        void addObjects(const Trade::SceneData& scene, Containers::ArrayView<const Containers::Optional<Trade::PhongMaterialData>> materials);
+        void loadCache(const SceneCache& cache);
+
+        /* Instance arrays for each level of detail of given texture and mesh,
+           created on first use */
+        Containers::ArrayView<Containers::Array<InstanceData>> batch(Int textureId, UnsignedInt meshId);
+
+        void addCullingNode(Object3D& object, Int parent, const Matrix4& transformation);
+        void updateCullingBounds();
+        void cullObjects();
+        void drawBatches();
+
+        Shaders::PhongGL _coloredShader{Shaders::PhongGL::Configuration{}
+            .setFlags(Shaders::PhongGL::Flag::VertexColor|
+                      Shaders::PhongGL::Flag::InstancedTransformation)};
         Shaders::PhongGL _texturedShader{Shaders::PhongGL::Configuration{}
-            .setFlags(Shaders::PhongGL::Flag::DiffuseTexture)};
-        Containers::Array<Containers::Optional<GL::Mesh>> _meshes;
+            .setFlags(Shaders::PhongGL::Flag::DiffuseTexture|
+                      Shaders::PhongGL::Flag::VertexColor|
+                      Shaders::PhongGL::Flag::InstancedTransformation)};
+        Containers::Array<GL::Mesh> _meshes;
+        /* Simplified levels of each mesh, sharing its instance buffer */
+        Containers::Array<Containers::Array<GL::Mesh>> _lodMeshes;
+        Containers::Array<MeshInfo> _meshInfo;
+        Containers::Array<GL::Buffer> _instanceBuffers;
         Containers::Array<Containers::Optional<GL::Texture2D>> _textures;
+        Containers::Array<Containers::Optional<Trade::TextureData>> _textureData;
+
+        Containers::Pointer<AssetLoader> _loader;
+        std::chrono::duration<Float, std::milli> _uploadBudget;
+        UnsignedInt _lodLevels;
+        Float _lodDistance;
+        /* Collects the imported data if --cache is enabled and the cache
+           wasn't loaded, saved once the loader is done */
+        Containers::String _cacheFilename;
+        Containers::Pointer<SceneCacheWriter> _cacheWriter;
 
         Scene3D _scene;
         Object3D _manipulator, _cameraObject;
         SceneGraph::Camera3D* _camera;
         SceneGraph::DrawableGroup3D _drawables;
+        /* Instances of objects sharing a texture and a mesh, for each level
+           of detail, filled by the drawables every frame. Texture ID is -1
+           for objects with just a color, the map ordering makes those drawn
+           first and the rest grouped by texture. */
+        std::map<std::pair<Int, UnsignedInt>, Containers::Array<Containers::Array<InstanceData>>> _batches;
+        /* Built on the first frame, bounds are updated when meshes get
+           uploaded */
+        Containers::Array<CullingNode> _cullingNodes;
+        Containers::Array<BatchedDrawable*> _cullingDrawables;
+        bool _cullingBoundsDirty = true;
+        /* Drawables that passed culling in the last frame and their counts.
+           Drawables with no mesh uploaded yet are counted as neither. */
+        std::vector<std::pair<std::reference_wrapper<SceneGraph::Drawable3D>, Matrix4>> _visibleDrawables;
+        UnsignedInt _drawnCount = 0, _culledCount = 0, _pendingCount = 0;
         Vector3 _previousPosition;
 };
 
-class ColoredDrawable: public SceneGraph::Drawable3D {
+class BatchedDrawable: public SceneGraph::Drawable3D {
     public:
-        explicit ColoredDrawable(Object3D& object, Shaders::PhongGL& shader, GL::Mesh& mesh, const Color4& color, SceneGraph::DrawableGroup3D& group): SceneGraph::Drawable3D{object, &group}, _shader(shader), _mesh(mesh), _color{color} {}
-
-    private:
-        void draw(const Matrix4& transformationMatrix, SceneGraph::Camera3D& camera) override;
+        explicit BatchedDrawable(Object3D& object, Containers::ArrayView<Containers::Array<InstanceData>> levels, const MeshInfo& mesh, const Color4& color, SceneGraph::DrawableGroup3D& group): SceneGraph::Drawable3D{object, &group}, _levels{levels}, _mesh(mesh), _color{color} {}
 
-        Shaders::PhongGL& _shader;
-        GL::Mesh& _mesh;
-        Color4 _color;
-};
-
-class TexturedDrawable: public SceneGraph::Drawable3D {
-    public:
-        explicit TexturedDrawable(Object3D& object, Shaders::PhongGL& shader, GL::Mesh& mesh, GL::Texture2D& texture, SceneGraph::DrawableGroup3D& group): SceneGraph::Drawable3D{object, &group}, _shader(shader), _mesh(mesh), _texture(texture) {}
+        const MeshInfo& mesh() const { return _mesh; }
 
     private:
         void draw(const Matrix4& transformationMatrix, SceneGraph::Camera3D& camera) override;
 
-        Shaders::PhongGL& _shader;
-        GL::Mesh& _mesh;
-        GL::Texture2D& _texture;
+        Containers::ArrayView<Containers::Array<InstanceData>> _levels;
+        const MeshInfo& _mesh;
+        Color4 _color;
 };
 
 ViewerExample::ViewerExample(const Arguments& arguments):
@@ -124,10 +220,25 @@ ViewerExample::ViewerExample(const Arguments& arguments):
     args.addArgument("file").setHelp("file", "file to load")
         .addOption("importer", "AnySceneImporter")
             .setHelp("importer", "importer plugin to use")
+        .addOption("loader-threads")
+            .setHelp("loader-threads", "threads importing images and meshes, 0 imports them on the main thread, default is one less than hardware threads", "N")
+        .addOption("upload-budget", "4")
+            .setHelp("upload-budget", "milliseconds spent uploading loaded assets each frame", "MS")
+        .addBooleanOption("optimize-meshes")
+            .setHelp("optimize-meshes", "deduplicate, reorder and pack mesh data before uploading")
+        .addOption("lod-levels", "0")
+            .setHelp("lod-levels", "simplified levels of detail generated for each mesh", "N")
+        .addOption("lod-distance", "8")
+            .setHelp("lod-distance", "distance from the camera in multiples of the mesh bounding radius at which the first simplified level is used, each next level is used when the distance doubles", "K")
+        .addBooleanOption("cache")
+            .setHelp("cache", "load the processed scene from a cache file next to it, or save it there if the cache doesn't exist or is outdated. Meshes are cached the way they were processed when the cache was made.")
         .addSkippedPrefix("magnum", "engine-specific options")
         .setGlobalHelp("Displays a 3D scene file provided on command line.")
         .parse(arguments.argc, arguments.argv);
 
+    _lodLevels = args.value<UnsignedInt>("lod-levels");
+    _lodDistance = args.value<Float>("lod-distance");
+
     _cameraObject
         .setParent(&_scene)
         .translate(Vector3::zAxis(5.0f));
@@ -152,102 +263,132 @@ ViewerExample::ViewerExample(const Arguments& arguments):
         .setSpecularColor(0x111111_rgbf)
         .setShininess(80.0f);
 
-    /* Load a scene importer plugin */
-    PluginManager::Manager<Trade::AbstractImporter> manager;
-    Containers::Pointer<Trade::AbstractImporter> importer =
-        manager.loadAndInstantiate(args.value("importer"));
-
-    if(!importer || !importer->openFile(args.value("file")))
-        std::exit(1);
-
-    /* Load all textures. Textures that fail to load will be NullOpt. */
-    _textures = Containers::Array<Containers::Optional<GL::Texture2D>>{
-        importer->textureCount()};
-    for(UnsignedInt i = 0; i != importer->textureCount(); ++i) {
-        Containers::Optional<Trade::TextureData> textureData =
-            importer->texture(i);
-        if(!textureData || textureData->type() != Trade::TextureType::Texture2D) {
-            Warning{} << "Cannot load texture" << i
-                << importer->textureName(i);
-            continue;
-        }
-
-        Containers::Optional<Trade::ImageData2D> imageData =
-            importer->image2D(textureData->image());
-        if(!imageData || imageData->isCompressed()) {
-            Warning{} << "Cannot load image" << textureData->image()
-                << importer->image2DName(textureData->image());
-            continue;
+    /* If the cache is up-to-date with the file, take everything from there
+       without involving the importer at all */
+    if(args.isSet("cache")) {
+        _cacheFilename = Utility::format("{}.viewer-cache", args.value("file"));
+        if(Containers::Optional<SceneCache> cache =
+            SceneCache::open(_cacheFilename, args.value("file")))
+        {
+            Debug{} << "Loading from" << _cacheFilename;
+            loadCache(*cache);
+            return;
         }
-
-        (*(_textures[i] = GL::Texture2D{}))
-            .setMagnificationFilter(textureData->magnificationFilter())
-            .setMinificationFilter(textureData->minificationFilter(),
-                                   textureData->mipmapFilter())
-            .setWrapping(textureData->wrapping().xy())
-            .setStorage(Math::log2(imageData->size().max()) + 1,
-                GL::textureFormat(imageData->format()), imageData->size())
-            .setSubImage(0, {}, *imageData)
-            .generateMipmap();
     }
 
-    /* Load all materials. Materials that fail to load will be NullOpt. Only a
-       temporary array as the material attributes will be stored directly in
-       drawables later. */
-    Containers::Array<Containers::Optional<Trade::PhongMaterialData>> materials{
-        importer->materialCount()};
-    for(UnsignedInt i = 0; i != importer->materialCount(); ++i) {
-        Containers::Optional<Trade::MaterialData> materialData;
-        if(!(materialData = importer->material(i))) {
-            Warning{} << "Cannot load material" << i
-                << importer->materialName(i);
-            continue;
+    /* Everything needed from the importer is taken in this scope, so the
+       importer and its plugin manager are destroyed before the loader
+       workers start loading plugins of their own. Plugins can't be loaded
+       and unloaded concurrently. */
+    Containers::Array<UnsignedInt> images;
+    UnsignedInt meshCount;
+    {
+        /* Load a scene importer plugin */
+        PluginManager::Manager<Trade::AbstractImporter> manager;
+        Containers::Pointer<Trade::AbstractImporter> importer =
+            manager.loadAndInstantiate(args.value("importer"));
+
+        if(!importer || !importer->openFile(args.value("file")))
+            std::exit(1);
+
+        if(args.isSet("cache"))
+            _cacheWriter.emplace(args.value("file"), importer->textureCount(),
+                importer->materialCount(), importer->meshCount(),
+                importer->image2DCount());
+
+        /* Load all textures. Textures that fail to load will be NullOpt. The
+           images are imported later, until then the texture contains a
+           single gray pixel. */
+        _textures = Containers::Array<Containers::Optional<GL::Texture2D>>{
+            importer->textureCount()};
+        _textureData = Containers::Array<Containers::Optional<Trade::TextureData>>{
+            importer->textureCount()};
+        for(UnsignedInt i = 0; i != importer->textureCount(); ++i) {
+            Containers::Optional<Trade::TextureData> textureData =
+                importer->texture(i);
+            if(!textureData || textureData->type() != Trade::TextureType::Texture2D) {
+                Warning{} << "Cannot load texture" << i
+                    << importer->textureName(i);
+                continue;
+            }
+
+            const Color4ub placeholder = 0x808080ff_rgba;
+            (*(_textures[i] = GL::Texture2D{}))
+                .setStorage(1, GL::textureFormat(PixelFormat::RGBA8Unorm), Vector2i{1})
+                .setSubImage(0, {}, ImageView2D{PixelFormat::RGBA8Unorm, Vector2i{1},
+                    Containers::arrayView(&placeholder, 1)});
+
+            if(std::find(images.begin(), images.end(), textureData->image()) == images.end())
+                arrayAppend(images, textureData->image());
+            if(_cacheWriter) _cacheWriter->setTexture(i, *textureData);
+            _textureData[i] = std::move(textureData);
         }
 
-        materials[i] = std::move(*materialData).as<Trade::PhongMaterialData>();
-    }
-
-    /* Load all meshes. Meshes that fail to load will be NullOpt. Generate
-       normals if not present. */
-    _meshes = Containers::Array<Containers::Optional<GL::Mesh>>{
-        importer->meshCount()};
-    for(UnsignedInt i = 0; i != importer->meshCount(); ++i) {
-        Containers::Optional<Trade::MeshData> meshData;
-        if(!(meshData = importer->mesh(i))) {
-            Warning{} << "Cannot load mesh" << i << importer->meshName(i);
-            continue;
+        /* Load all materials. Materials that fail to load will be NullOpt.
+           Only a temporary array as the material attributes will be stored
+           directly in drawables later. */
+        Containers::Array<Containers::Optional<Trade::PhongMaterialData>> materials{
+            importer->materialCount()};
+        for(UnsignedInt i = 0; i != importer->materialCount(); ++i) {
+            Containers::Optional<Trade::MaterialData> materialData;
+            if(!(materialData = importer->material(i))) {
+                Warning{} << "Cannot load material" << i
+                    << importer->materialName(i);
+                continue;
+            }
+
+            materials[i] = std::move(*materialData).as<Trade::PhongMaterialData>();
+            if(_cacheWriter) _cacheWriter->setMaterial(i, *materials[i]);
         }
 
-        MeshTools::CompileFlags flags;
-        if(!meshData->hasAttribute(Trade::MeshAttribute::Normal))
-            flags |= MeshTools::CompileFlag::GenerateFlatNormals;
-        _meshes[i] = MeshTools::compile(*meshData, flags);
-    }
+        /* Meshes are empty until the loader below imports them, meshes that
+           fail to load stay empty */
+        _meshes = Containers::Array<GL::Mesh>{importer->meshCount()};
+        _lodMeshes = Containers::Array<Containers::Array<GL::Mesh>>{importer->meshCount()};
+        _meshInfo = Containers::Array<MeshInfo>{ValueInit, importer->meshCount()};
+        _instanceBuffers = Containers::Array<GL::Buffer>{importer->meshCount()};
+
+        /* The format has no scene support, display just the first mesh with a
+           default material (if it's there) */
+        if(importer->defaultScene() == -1) {
+            if(!_meshes.isEmpty())
+                new BatchedDrawable{_manipulator, batch(-1, 0), _meshInfo[0],
+                    0xffffff_rgbf, _drawables};
+
+        /* Load the scene */
+        } else {
+            Containers::Optional<Trade::SceneData> scene;
+            if(!(scene = importer->scene(importer->defaultScene())) ||
+               !scene->is3D() ||
+               !scene->hasField(Trade::SceneField::Parent) ||
+               !scene->hasField(Trade::SceneField::Mesh))
+            {
+                Fatal{} << "Cannot load scene" << importer->defaultScene()
+                    << importer->sceneName(importer->defaultScene());
+            }
+
+            if(_cacheWriter) _cacheWriter->setScene(*scene);
+            addObjects(*scene, materials);
+        }
 
-    /* The format has no scene support, display just the first loaded mesh with
-       a default material (if it's there) and be done with it. */
-    if(importer->defaultScene() == -1) {
-        if(!_meshes.isEmpty() && _meshes[0])
-            new ColoredDrawable{_manipulator, _coloredShader, *_meshes[0],
-                0xffffff_rgbf, _drawables};
-        return;
+        meshCount = importer->meshCount();
     }
 
-    /* Load the scene */
-    Containers::Optional<Trade::SceneData> scene;
-    if(!(scene = importer->scene(importer->defaultScene())) ||
-       !scene->is3D() ||
-       !scene->hasField(Trade::SceneField::Parent) ||
-       !scene->hasField(Trade::SceneField::Mesh))
-    {
-        Fatal{} << "Cannot load scene" << importer->defaultScene()
-            << importer->sceneName(importer->defaultScene());
-    }
+    /* Import images and meshes in the background */
+    _loader.emplace(args.value("importer"), args.value("file"), images,
+        meshCount, args.value("loader-threads").isEmpty() ?
+            Math::max(std::thread::hardware_concurrency(), 2u) - 1 :
+            args.value<UnsignedInt>("loader-threads"),
+        args.isSet("optimize-meshes"), _lodLevels);
+    _uploadBudget = std::chrono::duration<Float, std::milli>{
+        args.value<Float>("upload-budget")};
+}
 
+void ViewerExample::addObjects(const Trade::SceneData& scene, const Containers::ArrayView<const Containers::Optional<Trade::PhongMaterialData>> materials) {
     /* Allocate objects that are part of the hierarchy */
-    Containers::Array<Object3D*> objects{std::size_t(scene->mappingBound())};
+    Containers::Array<Object3D*> objects{std::size_t(scene.mappingBound())};
     Containers::Array<Containers::Pair<UnsignedInt, Int>> parents
-        = scene->parentsAsArray();
+        = scene.parentsAsArray();
     for(const Containers::Pair<UnsignedInt, Int>& parent: parents)
         objects[parent.first()] = new Object3D{};
 
@@ -260,7 +401,7 @@ ViewerExample::ViewerExample(const Arguments& arguments):
        ignored, objects that have no transformation entry retain an identity
        transformation. */
     for(const Containers::Pair<UnsignedInt, Matrix4>& transformation:
-        scene->transformations3DAsArray())
+        scene.transformations3DAsArray())
     {
         if(Object3D* object = objects[transformation.first()])
             object->setTransformation(transformation.second());
@@ -270,70 +411,376 @@ ViewerExample::ViewerExample(const Arguments& arguments):
        are not part of the hierarchy. There can be multiple mesh assignments
        for one object, simply add one drawable for each. */
     for(const Containers::Pair<UnsignedInt, Containers::Pair<UnsignedInt, Int>>&
-        meshMaterial: scene->meshesMaterialsAsArray())
+        meshMaterial: scene.meshesMaterialsAsArray())
     {
         Object3D* object = objects[meshMaterial.first()];
-        Containers::Optional<GL::Mesh>& mesh =
-            _meshes[meshMaterial.second().first()];
-        if(!object || !mesh) continue;
+        const UnsignedInt meshId = meshMaterial.second().first();
+        if(!object) continue;
 
         Int materialId = meshMaterial.second().second();
 
         /* Material not available / not loaded, use a default material */
         if(materialId == -1 || !materials[materialId]) {
-            new ColoredDrawable{*object, _coloredShader, *mesh, 0xffffff_rgbf,
-                _drawables};
+            new BatchedDrawable{*object, batch(-1, meshId),
+                _meshInfo[meshId], 0xffffff_rgbf, _drawables};
 
         /* Textured material, if the texture loaded correctly */
         } else if(materials[materialId]->hasAttribute(
                 Trade::MaterialAttribute::DiffuseTexture
             ) && _textures[materials[materialId]->diffuseTexture()])
         {
-            new TexturedDrawable{*object, _texturedShader, *mesh,
-                *_textures[materials[materialId]->diffuseTexture()],
-                _drawables};
+            new BatchedDrawable{*object,
+                batch(Int(materials[materialId]->diffuseTexture()), meshId),
+                _meshInfo[meshId], 0xffffff_rgbf, _drawables};
 
         /* Color-only material */
         } else {
-            new ColoredDrawable{*object, _coloredShader, *mesh,
-                materials[materialId]->diffuseColor(), _drawables};
+            new BatchedDrawable{*object, batch(-1, meshId),
+                _meshInfo[meshId], materials[materialId]->diffuseColor(),
+                _drawables};
         }
     }
 }
 
-void ColoredDrawable::draw(const Matrix4& transformationMatrix, SceneGraph::Camera3D& camera) {
-    _shader
-        .setDiffuseColor(_color)
-        .setLightPositions({
-            {camera.cameraMatrix().transformPoint({-3.0f, 10.0f, 10.0f}), 0.0f}
-        })
-        .setTransformationMatrix(transformationMatrix)
-        .setNormalMatrix(transformationMatrix.normalMatrix())
-        .setProjectionMatrix(camera.projectionMatrix())
-        .draw(_mesh);
+Containers::ArrayView<Containers::Array<InstanceData>> ViewerExample::batch(const Int textureId, const UnsignedInt meshId) {
+    Containers::Array<Containers::Array<InstanceData>>& levels = _batches[{textureId, meshId}];
+    if(levels.isEmpty())
+        levels = Containers::Array<Containers::Array<InstanceData>>{_lodLevels + 1};
+    return levels;
 }
 
-void TexturedDrawable::draw(const Matrix4& transformationMatrix, SceneGraph::Camera3D& camera) {
-    _shader
-        .setLightPositions({
-            {camera.cameraMatrix().transformPoint({-3.0f, 10.0f, 10.0f}), 0.0f}
-        })
-        .setTransformationMatrix(transformationMatrix)
-        .setNormalMatrix(transformationMatrix.normalMatrix())
-        .setProjectionMatrix(camera.projectionMatrix())
-        .bindDiffuseTexture(_texture)
-        .draw(_mesh);
+void BatchedDrawable::draw(const Matrix4& transformationMatrix, SceneGraph::Camera3D&) {
+    /* Pick a coarser level each time the distance doubles. The distance is
+       in the object's own scale to match the mesh bounds. */
+    UnsignedInt level = 0;
+    if(_mesh.levelCount > 1) {
+        const Float distance = transformationMatrix.transformPoint(
+            _mesh.bounds.center()).length()/transformationMatrix.scaling().max();
+        if(distance > _mesh.lodDistance)
+            level = Math::min(
+                UnsignedInt(std::log2(distance/_mesh.lodDistance)) + 1,
+                _mesh.levelCount - 1);
+    }
+
+    arrayAppend(_levels[level], InPlaceInit, transformationMatrix,
+        transformationMatrix.normalMatrix(), _color);
 }
 
 void ViewerExample::drawEvent() {
+    /* Upload what got imported since the last frame */
+    if(_loader) uploadLoadedAssets();
+
     GL::defaultFramebuffer.clear(GL::FramebufferClear::Color|
                                  GL::FramebufferClear::Depth);
 
-    _camera->draw(_drawables);
+    /* Collect transformations of visible objects into their batches */
+    for(auto& batch: _batches)
+        for(Containers::Array<InstanceData>& instances: batch.second)
+            arrayClear(instances);
+    cullObjects();
+    _camera->draw(_visibleDrawables);
+
+    drawBatches();
 
     swapBuffers();
 }
 
+namespace {
+
+/* Bounds of a range after a transformation, still axis-aligned */
+Range3D transformRange(const Matrix4& transformation, const Range3D& range) {
+    const Matrix3x3 rotationScaling = transformation.rotationScaling();
+    const Vector3 halfSize = range.size()/2.0f;
+    Vector3 extent;
+    for(std::size_t i = 0; i != 3; ++i)
+        extent += Math::abs(rotationScaling[i])*halfSize[i];
+    return Range3D::fromCenter(transformation.transformPoint(range.center()), extent);
+}
+
+/* Unlike Math::join() this doesn't treat zero-size ranges as empty, only
+   ranges with min larger than max */
+Range3D joinBounds(const Range3D& a, const Range3D& b) {
+    return {Math::min(a.min(), b.min()), Math::max(a.max(), b.max())};
+}
+
+bool isVisible(const Range3D& bounds, const Frustum& frustum) {
+    return bounds.min().x() <= bounds.max().x() &&
+        Math::Intersection::rangeFrustum(bounds, frustum);
+}
+
+}
+
+void ViewerExample::addCullingNode(Object3D& object, const Int parent, const Matrix4& transformation) {
+    const UnsignedInt id = _cullingNodes.size();
+    const UnsignedInt drawableOffset = _cullingDrawables.size();
+    for(SceneGraph::AbstractFeature3D* feature = object.features().first(); feature; feature = feature->nextFeature()) {
+        if(BatchedDrawable* drawable = dynamic_cast<BatchedDrawable*>(feature))
+            arrayAppend(_cullingDrawables, drawable);
+    }
+    arrayAppend(_cullingNodes, InPlaceInit, transformation, parent, 0u,
+        drawableOffset, UnsignedInt(_cullingDrawables.size()) - drawableOffset,
+        0u, 0u, Range3D{}, Range3D{});
+
+    for(Object3D* child = object.children().first(); child; child = child->nextSibling())
+        addCullingNode(*child, id, transformation*child->transformationMatrix());
+
+    _cullingNodes[id].subtreeEnd = _cullingNodes.size();
+}
+
+void ViewerExample::updateCullingBounds() {
+    const Range3D empty{Vector3{Constants::inf()}, Vector3{-Constants::inf()}};
+    for(CullingNode& node: _cullingNodes) {
+        node.subtreeBounds = empty;
+        node.subtreeLoadedDrawableCount = 0;
+    }
+
+    /* Children are after their parents, so going backwards each subtree is
+       finished before it's added to its parent */
+    for(std::size_t i = _cullingNodes.size(); i != 0; --i) {
+        CullingNode& node = _cullingNodes[i - 1];
+        node.bounds = empty;
+        node.loadedDrawableCount = 0;
+        for(std::size_t j = node.drawableOffset; j != node.drawableOffset + node.drawableCount; ++j) {
+            const MeshInfo& mesh = _cullingDrawables[j]->mesh();
+            if(!mesh.levelCount) continue;
+            node.bounds = joinBounds(node.bounds,
+                transformRange(node.transformation, mesh.bounds));
+            ++node.loadedDrawableCount;
+        }
+
+        node.subtreeBounds = joinBounds(node.subtreeBounds, node.bounds);
+        node.subtreeLoadedDrawableCount += node.loadedDrawableCount;
+        if(node.parent != -1) {
+            _cullingNodes[node.parent].subtreeBounds = joinBounds(
+                _cullingNodes[node.parent].subtreeBounds, node.subtreeBounds);
+            _cullingNodes[node.parent].subtreeLoadedDrawableCount += node.subtreeLoadedDrawableCount;
+        }
+    }
+}
+
+void ViewerExample::cullObjects() {
+    /* The hierarchy doesn't change after the constructor, so it's built just
+       once. Bounds change as meshes get loaded. */
+    if(_cullingNodes.isEmpty())
+        addCullingNode(_manipulator, -1, Matrix4{});
+    if(_cullingBoundsDirty) {
+        updateCullingBounds();
+        _cullingBoundsDirty = false;
+    }
+
+    /* Transform the frustum to the manipulator space instead of transforming
+       all bounds to the camera space */
+    const Matrix4 manipulatorToCamera =
+        _camera->cameraMatrix()*_manipulator.transformationMatrix();
+    const Frustum frustum = Frustum::fromMatrix(
+        _camera->projectionMatrix()*manipulatorToCamera);
+
+    _visibleDrawables.clear();
+    _drawnCount = 0;
+    _culledCount = 0;
+    _pendingCount = _cullingDrawables.size() - _cullingNodes[0].subtreeLoadedDrawableCount;
+    for(std::size_t i = 0; i != _cullingNodes.size(); ) {
+        const CullingNode& node = _cullingNodes[i];
+
+        /* Skip the whole subtree if it's outside */
+        if(!isVisible(node.subtreeBounds, frustum)) {
+            _culledCount += node.subtreeLoadedDrawableCount;
+            i = node.subtreeEnd;
+            continue;
+        }
+
+        if(isVisible(node.bounds, frustum)) {
+            const Matrix4 transformation = manipulatorToCamera*node.transformation;
+            for(std::size_t j = node.drawableOffset; j != node.drawableOffset + node.drawableCount; ++j)
+                _visibleDrawables.emplace_back(*_cullingDrawables[j], transformation);
+            _drawnCount += node.loadedDrawableCount;
+        } else _culledCount += node.loadedDrawableCount;
+
+        ++i;
+    }
+}
+
+void ViewerExample::drawBatches() {
+    /* The light and the projection are the same for all objects, so set them
+       just once per frame */
+    const Vector4 lightPosition{_camera->cameraMatrix().transformPoint(
+        {-3.0f, 10.0f, 10.0f}), 0.0f};
+    _coloredShader
+        .setLightPositions({lightPosition})
+        .setProjectionMatrix(_camera->projectionMatrix());
+    _texturedShader
+        .setLightPositions({lightPosition})
+        .setProjectionMatrix(_camera->projectionMatrix());
+
+    Int boundTexture = -1;
+    for(auto& batch: _batches) for(std::size_t level = 0; level != batch.second.size(); ++level) {
+        const Int textureId = batch.first.first;
+        const UnsignedInt meshId = batch.first.second;
+        const Containers::Array<InstanceData>& instances = batch.second[level];
+        if(instances.isEmpty()) continue;
+
+        /* Skip meshes that aren't loaded (yet). Simplified levels get
+           instances only once they're loaded. */
+        GL::Mesh& mesh = level ? _lodMeshes[meshId][level - 1] : _meshes[meshId];
+        if(!mesh.count()) continue;
+
+        /* Orphan the previous buffer contents, as the same mesh can be
+           drawn by more than one batch */
+        _instanceBuffers[meshId].setData(instances, GL::BufferUsage::DynamicDraw);
+        mesh.setInstanceCount(instances.size());
+
+        if(textureId == -1) {
+            _coloredShader.draw(mesh);
+            continue;
+        }
+
+        /* Batches with the same texture are next to each other, bind it only
+           when it changes */
+        if(textureId != boundTexture) {
+            _texturedShader.bindDiffuseTexture(*_textures[textureId]);
+            boundTexture = textureId;
+        }
+        _texturedShader.draw(mesh);
+    }
+}
+
+void ViewerExample::uploadLoadedAssets() {
+    /* Upload at least one asset every frame even if the budget is zero, then
+       continue only until the budget is exhausted */
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    do {
+        Containers::Optional<AssetLoader::Asset> asset = _loader->next();
+        if(!asset) break;
+
+        if(asset->type == AssetLoader::Asset::Type::Image) {
+            if(!asset->image || asset->image->isCompressed()) {
+                Warning{} << "Cannot load image" << asset->id;
+                continue;
+            }
+            uploadImage(asset->id, *asset->image);
+            if(_cacheWriter) _cacheWriter->setImage(asset->id, *asset->image);
+        } else {
+            if(!asset->mesh) {
+                Warning{} << "Cannot load mesh" << asset->id;
+                continue;
+            }
+            uploadMesh(asset->id, *asset->mesh, asset->lods);
+            if(_cacheWriter) _cacheWriter->setMesh(asset->id, *asset->mesh);
+        }
+    } while(std::chrono::steady_clock::now() - start < _uploadBudget);
+
+    if(_loader->isDone()) {
+        Debug{} << "Meshes have" << _loader->vertexCount() << "vertices and"
+            << _loader->meshDataSize()/1024 << "kB of data, imported"
+            << _loader->importedVertexCount() << "vertices and"
+            << _loader->importedMeshDataSize()/1024 << "kB";
+        _loader = nullptr;
+
+        if(_cacheWriter) {
+            if(_cacheWriter->save(_cacheFilename))
+                Debug{} << "Saved the scene to" << _cacheFilename;
+            else
+                Warning{} << "Cannot save the scene to" << _cacheFilename;
+            _cacheWriter = nullptr;
+        }
+    }
+
+    /* Draw again to upload the rest or to show the last uploaded assets */
+    redraw();
+}
+
+void ViewerExample::uploadImage(const UnsignedInt id, const Trade::ImageData2D& image) {
+    /* Replace the placeholder in all textures using this image, drawables
+       reference the texture slot so they don't need to be updated. With the
+       cache there are no placeholders, the texture gets created here. */
+    for(std::size_t i = 0; i != _textures.size(); ++i) {
+        const Containers::Optional<Trade::TextureData>& textureData = _textureData[i];
+        if(!textureData || textureData->image() != id) continue;
+
+        (*(_textures[i] = GL::Texture2D{}))
+            .setMagnificationFilter(textureData->magnificationFilter())
+            .setMinificationFilter(textureData->minificationFilter(),
+                                   textureData->mipmapFilter())
+            .setWrapping(textureData->wrapping().xy())
+            .setStorage(Math::log2(image.size().max()) + 1,
+                GL::textureFormat(image.format()), image.size())
+            .setSubImage(0, {}, image)
+            .generateMipmap();
+    }
+}
+
+void ViewerExample::uploadMesh(const UnsignedInt id, const Trade::MeshData& meshData, const Containers::ArrayView<const Trade::MeshData> lods) {
+    _meshes[id] = compileMesh(id, meshData);
+    _lodMeshes[id] = Containers::Array<GL::Mesh>{lods.size()};
+    for(std::size_t i = 0; i != lods.size(); ++i)
+        _lodMeshes[id][i] = compileMesh(id, lods[i]);
+
+    /* Bounds used for culling and for picking the level of detail */
+    MeshInfo& info = _meshInfo[id];
+    if(meshData.hasAttribute(Trade::MeshAttribute::Position))
+        info.bounds = Math::minmax(meshData.positions3DAsArray());
+    info.levelCount = 1 + lods.size();
+    info.lodDistance = _lodDistance*info.bounds.size().length()*0.5f;
+    _cullingBoundsDirty = true;
+}
+
+GL::Mesh ViewerExample::compileMesh(const UnsignedInt id, const Trade::MeshData& meshData) {
+    /* Generate normals if not present */
+    MeshTools::CompileFlags flags;
+    if(!meshData.hasAttribute(Trade::MeshAttribute::Normal))
+        flags |= MeshTools::CompileFlag::GenerateFlatNormals;
+    GL::Mesh mesh = MeshTools::compile(meshData, flags);
+
+    /* Per-instance transformation and color, filled in drawBatches(). Vertex
+       colors of the mesh itself, if any, are overridden by it. All levels of
+       detail of a mesh share the same buffer. */
+    mesh.addVertexBufferInstanced(_instanceBuffers[id], 1, 0,
+        Shaders::PhongGL::TransformationMatrix{},
+        Shaders::PhongGL::NormalMatrix{},
+        Shaders::PhongGL::Color4{});
+    return mesh;
+}
+
+void ViewerExample::loadCache(const SceneCache& cache) {
+    /* The images are uploaded right away, so there's no need for
+       placeholders. Textures whose image isn't in the cache stay NullOpt and
+       objects using them are drawn just with a color. */
+    _textures = Containers::Array<Containers::Optional<GL::Texture2D>>{
+        cache.textureCount()};
+    _textureData = Containers::Array<Containers::Optional<Trade::TextureData>>{
+        cache.textureCount()};
+    for(UnsignedInt i = 0; i != cache.textureCount(); ++i)
+        _textureData[i] = cache.texture(i);
+    for(UnsignedInt i = 0; i != cache.imageCount(); ++i) {
+        if(Containers::Optional<Trade::ImageData2D> image = cache.image(i))
+            uploadImage(i, *image);
+    }
+
+    /* The mesh data reference the mapped file directly */
+    _meshes = Containers::Array<GL::Mesh>{cache.meshCount()};
+    _lodMeshes = Containers::Array<Containers::Array<GL::Mesh>>{cache.meshCount()};
+    _meshInfo = Containers::Array<MeshInfo>{ValueInit, cache.meshCount()};
+    _instanceBuffers = Containers::Array<GL::Buffer>{cache.meshCount()};
+    for(UnsignedInt i = 0; i != cache.meshCount(); ++i) {
+        if(Containers::Optional<Trade::MeshData> mesh = cache.mesh(i))
+            uploadMesh(i, *mesh, {});
+    }
+
+    Containers::Array<Containers::Optional<Trade::PhongMaterialData>> materials{
+        cache.materialCount()};
+    for(UnsignedInt i = 0; i != cache.materialCount(); ++i)
+        materials[i] = cache.material(i);
+
+    /* The scene is there only if the file had one, otherwise display just
+       the first mesh like when importing */
+    if(Containers::Optional<Trade::SceneData> scene = cache.scene())
+        addObjects(*scene, materials);
+    else if(!_meshes.isEmpty())
+        new BatchedDrawable{_manipulator, batch(-1, 0), _meshInfo[0],
+            0xffffff_rgbf, _drawables};
+}
+
 void ViewerExample::viewportEvent(ViewportEvent& event) {
     GL::defaultFramebuffer.setViewport({{}, event.framebufferSize()});
     _camera->setViewport(event.windowSize());
@@ -368,6 +815,24 @@ void ViewerExample::scrollEvent(ScrollEvent& event) {
     redraw();
 }
 
+void ViewerExample::keyPressEvent(KeyEvent& event) {
+    if(event.key() != Key::S) return;
+
+    /* The batches still contain instances of the last frame */
+    Debug{} << "Objects drawn:" << _drawnCount << "culled:" << _culledCount
+        << "still loading:" << _pendingCount;
+    if(_lodLevels) {
+        Containers::Array<std::size_t> instances{ValueInit, _lodLevels + 1};
+        for(auto& batch: _batches)
+            for(std::size_t level = 0; level != batch.second.size(); ++level)
+                instances[level] += batch.second[level].size();
+        for(std::size_t level = 0; level != instances.size(); ++level)
+            Debug{} << "Level" << level << "instances:" << instances[level];
+    }
+
+    event.setAccepted();
+}
+
 Vector3 ViewerExample::positionOnSphere(const Vector2& position) const {
     const Vector2 positionNormalized =
         position/Vector2{_camera->viewport()} - Vector2{0.5f};